@@ -0,0 +1,91 @@
+#include "audio.hpp"
+
+using std::memory_order_acquire;
+using std::memory_order_relaxed;
+using std::memory_order_release;
+
+static_assert((CHIP8_AUDIO_RING & (CHIP8_AUDIO_RING - 1)) == 0,
+              "audio ring size must be a power of two");
+
+size_t AudioRing::write(const int16_t* samples, size_t count) {
+  auto first = head.load(memory_order_relaxed);
+  auto last = tail.load(memory_order_acquire);
+  auto n = std::min(count, CHIP8_AUDIO_RING - (first - last));
+
+  auto start = first & (CHIP8_AUDIO_RING - 1);
+  auto chunk = std::min(n, CHIP8_AUDIO_RING - start);
+  memcpy(buffer + start, samples, chunk * sizeof(int16_t));
+  memcpy(buffer, samples + chunk, (n - chunk) * sizeof(int16_t));
+
+  head.store(first + n, memory_order_release);
+  return n;
+}
+
+size_t AudioRing::read(int16_t* samples, size_t count) {
+  auto first = tail.load(memory_order_relaxed);
+  auto last = head.load(memory_order_acquire);
+  auto n = std::min(count, last - first);
+
+  auto start = first & (CHIP8_AUDIO_RING - 1);
+  auto chunk = std::min(n, CHIP8_AUDIO_RING - start);
+  memcpy(samples, buffer + start, chunk * sizeof(int16_t));
+  memcpy(samples + chunk, buffer, (n - chunk) * sizeof(int16_t));
+
+  tail.store(first + n, memory_order_release);
+  if (n < count) {
+    starved.fetch_add(1, memory_order_relaxed);
+  }
+  return n;
+}
+
+size_t AudioRing::size() const {
+  return head.load(memory_order_acquire) - tail.load(memory_order_acquire);
+}
+
+uint64_t AudioRing::underruns() const {
+  return starved.load(memory_order_relaxed);
+}
+
+void AudioGenerator::generate(const Chip8Machine& chip8, AudioRing& ring,
+                              size_t count) {
+  count = std::min<size_t>(count, CHIP8_AUDIO_RING);
+
+  if (chip8.audioPattern) {
+    // XO-CHIP plays the 128-bit pattern at 4000 * 2^((pitch - 64) / 48) bits
+    // per second, the top 7 bits of the phase select the bit
+    auto rate = XOCHIP_AUDIO_RATE * std::exp2((chip8.pitch - 64) / 48.0);
+    const uint32_t step = rate * (1u << 25) / CHIP8_AUDIO_SAMPLE_RATE;
+    for (size_t i = 0; i < count; i++) {
+      auto bit = phase >> 25;
+      auto on = (chip8.pattern[bit >> 3] >> (7 - (bit & 7))) & 1;
+      if (chip8.soundTimer > 0) {
+        samples[i] = on ? CHIP8_AUDIO_VOLUME : -CHIP8_AUDIO_VOLUME;
+      } else {
+        samples[i] = 0;
+      }
+      phase += step;
+    }
+  } else {
+    const uint32_t step =
+        (uint64_t(CHIP8_AUDIO_TONE) << 32) / CHIP8_AUDIO_SAMPLE_RATE;
+    for (size_t i = 0; i < count; i++) {
+      if (chip8.soundTimer > 0) {
+        samples[i] =
+            (phase & 0x80000000) ? CHIP8_AUDIO_VOLUME : -CHIP8_AUDIO_VOLUME;
+      } else {
+        samples[i] = 0;
+      }
+      phase += step;
+    }
+  }
+
+  // keep queued audio under the latency budget, late samples are dropped
+  auto queued = ring.size();
+  if (queued < latency) {
+    ring.write(samples, std::min(count, latency - queued));
+  }
+}
+
+void AudioGenerator::setLatency(size_t samples) {
+  latency = std::min<size_t>(samples, CHIP8_AUDIO_RING);
+}
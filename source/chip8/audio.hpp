@@ -0,0 +1,55 @@
+#pragma once
+
+#include "chip8.hpp"
+
+#define CHIP8_AUDIO_SAMPLE_RATE 44100
+#define CHIP8_AUDIO_RING 2048
+#define CHIP8_AUDIO_LATENCY 735
+#define CHIP8_AUDIO_PERIOD 256
+#define CHIP8_AUDIO_TONE 440
+#define CHIP8_AUDIO_VOLUME 6000
+#define XOCHIP_AUDIO_RATE 4000
+
+using std::atomic;
+
+// Single producer (emulation thread), single consumer (audio device thread).
+// read() never blocks nor allocates so it is safe to call from the device
+// callback.
+class AudioRing {
+ private:
+  AudioRing(const AudioRing&) = delete;
+  AudioRing& operator=(const AudioRing&) = delete;
+
+ public:
+  AudioRing() = default;
+  ~AudioRing() = default;
+
+  size_t write(const int16_t* samples, size_t count);
+  size_t read(int16_t* samples, size_t count);
+  size_t size() const;
+  uint64_t underruns() const;
+
+ private:
+  alignas(64) atomic<size_t> head{0};
+  alignas(64) atomic<size_t> tail{0};
+  alignas(64) atomic<uint64_t> starved{0};
+  int16_t buffer[CHIP8_AUDIO_RING];
+};
+
+class AudioGenerator {
+ private:
+  AudioGenerator(const AudioGenerator&) = delete;
+  AudioGenerator& operator=(const AudioGenerator&) = delete;
+
+ public:
+  AudioGenerator() = default;
+  ~AudioGenerator() = default;
+
+  void generate(const Chip8Machine& chip8, AudioRing& ring, size_t count);
+  void setLatency(size_t samples);
+
+ private:
+  uint32_t phase = 0;
+  size_t latency = CHIP8_AUDIO_LATENCY;
+  int16_t samples[CHIP8_AUDIO_RING];
+};
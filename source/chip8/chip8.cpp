@@ -1,40 +1,431 @@
 #include "chip8.hpp"
 
-Chip8::Chip8() { reset(); }
+using std::make_unique;
 
-void Chip8::reset() {
+Chip8Machine::Chip8Machine(uint32_t capacity,
+                           const shared_ptr<const Chip8MemoryImage>& image)
+    : capacity(capacity) {
+  if (image && capacity <= XOCHIP_MEMORY_SIZE) {
+    this->image = image;
+    memory = nullptr;
+  } else {
+    storage.reset(new uint8_t[capacity]);
+    memory = storage.get();
+  }
+  mapPages();
+  reset();
+}
+
+unique_ptr<Chip8Machine> Chip8Machine::create(Chip8Profile profile) {
+  switch (profile) {
+    case Chip8Profile::Cosmac:
+      return make_unique<Chip8<CosmacQuirks>>();
+    case Chip8Profile::SuperChip:
+      return make_unique<Chip8<SuperChipQuirks>>();
+    case Chip8Profile::XoChip:
+      return make_unique<Chip8<XoChipQuirks>>();
+    case Chip8Profile::MegaChip:
+      return make_unique<Chip8<MegaChipQuirks>>();
+    case Chip8Profile::Modern:
+    default:
+      return make_unique<Chip8<ModernQuirks>>();
+  }
+}
+
+Chip8Machine* Chip8Machine::createAt(
+    void* place, Chip8Profile profile,
+    const shared_ptr<const Chip8MemoryImage>& image) {
+  switch (profile) {
+    case Chip8Profile::Cosmac:
+      return new (place) Chip8<CosmacQuirks>(image);
+    case Chip8Profile::SuperChip:
+      return new (place) Chip8<SuperChipQuirks>(image);
+    case Chip8Profile::XoChip:
+      return new (place) Chip8<XoChipQuirks>(image);
+    case Chip8Profile::MegaChip:
+      return new (place) Chip8<MegaChipQuirks>(image);
+    case Chip8Profile::Modern:
+    default:
+      return new (place) Chip8<ModernQuirks>(image);
+  }
+}
+
+size_t Chip8Machine::instanceSize(Chip8Profile profile) {
+  switch (profile) {
+    case Chip8Profile::Cosmac:
+      return sizeof(Chip8<CosmacQuirks>);
+    case Chip8Profile::SuperChip:
+      return sizeof(Chip8<SuperChipQuirks>);
+    case Chip8Profile::XoChip:
+      return sizeof(Chip8<XoChipQuirks>);
+    case Chip8Profile::MegaChip:
+      return sizeof(Chip8<MegaChipQuirks>);
+    case Chip8Profile::Modern:
+    default:
+      return sizeof(Chip8<ModernQuirks>);
+  }
+}
+
+size_t Chip8Machine::footprint() const {
+  auto bytes = instanceSize(profile()) + (storage ? capacity : 0) +
+               copies.capacity() * sizeof(copies[0]) +
+               copies.size() * CHIP8_PAGE_SIZE;
+  if (mega) {
+    bytes += sizeof(MegaChipScreen);
+  }
+  return bytes;
+}
+
+void Chip8Machine::reset() {
   pc = CHIP8_MEMORY_START;
   sp = 0;
-  memset(memory, 0, sizeof(memory));
-  memset(video, 0, sizeof(video));
+  index = 0;
+  delayTimer = 0;
+  soundTimer = 0;
+  pitch = XOCHIP_PITCH;
+  audioPattern = false;
+  instruction = 0;
+  exited = false;
+  if (image) {
+    mapPages();
+  } else {
+    memset(memory, 0, capacity);
+  }
+  memset(&screen, 0, sizeof(screen));
+  screen.selected = 1;
+  memoryHash = 0;
+  memset(planeHash, 0, sizeof(planeHash));
+  if (mega) {
+    mega->reset();
+  }
+  memset(pattern, 0, sizeof(pattern));
+  memset(registers, 0, sizeof(registers));
+  memset(flags, 0, sizeof(flags));
+  memset(stack, 0, sizeof(stack));
   memset(keyboard, 0, sizeof(keyboard));
 }
 
-void Chip8::setMemory(uint16_t start, const vector<uint8_t>& code) {
+void Chip8Machine::setMemory(uint16_t start, const vector<uint8_t>& code) {
   auto address = start;
   for (auto opcode : code) {
-    memory[address] = opcode;
+    write(address, opcode);
     address++;
   }
 }
 
-void Chip8::setVideo(uint16_t start, const vector<int32_t>& screen) {
+void Chip8Machine::copyMemory(uint32_t address, const uint8_t* data,
+                              size_t size) {
+  if (memory && !hashing) {
+    memcpy(memory + address, data, size);
+    return;
+  }
+  for (size_t i = 0; i < size; i++) {
+    write(address + i, data[i]);
+  }
+}
+
+void Chip8Machine::setVideo(uint16_t start, const vector<int32_t>& pixels) {
   auto address = start;
-  for (auto pixel : screen) {
-    video[address] = pixel;
+  for (auto pixel : pixels) {
+    auto x = address % screen.width();
+    auto y = address / screen.width();
+    uint64_t mask = 0x8000000000000000ull >> (x & 63);
+    if (pixel) {
+      screen.planes[0][y][x >> 6] |= mask;
+    } else {
+      screen.planes[0][y][x >> 6] &= ~mask;
+    }
+    screen.dirty |= 1ull << y;
     address++;
   }
+  hashScreen();
+}
+
+void Chip8Machine::dirtyRows(uint64_t* rows) const {
+  if (mega && mega->enabled) {
+    for (auto i = 0; i < CHIP8_DIRTY_WORDS; i++) {
+      rows[i] |= mega->dirty[i];
+    }
+  } else {
+    rows[0] |= screen.dirty;
+  }
+}
+
+void Chip8Machine::markDirty(const uint64_t* rows) {
+  if (mega && mega->enabled) {
+    for (auto i = 0; i < CHIP8_DIRTY_WORDS; i++) {
+      mega->dirty[i] |= rows[i];
+    }
+  } else {
+    screen.dirty |= rows[0];
+  }
 }
 
-void Chip8::setStack(const vector<uint16_t>& addrs) {
+void Chip8Machine::clearDirty() {
+  screen.dirty = 0;
+  if (mega) {
+    memset(mega->dirty, 0, sizeof(mega->dirty));
+  }
+}
+
+void Chip8Machine::setStack(const vector<uint16_t>& addrs) {
   for (auto addr : addrs) {
     stack[sp] = addr;
     sp++;
   }
 }
 
-void Chip8::execute() {
-  instruction = (memory[pc] << 8) | memory[pc + 1];
+// Pages point at the private storage, or at the shared image until written.
+// Image pages are never written through: write() owns the page first.
+void Chip8Machine::mapPages() {
+  auto base = image ? const_cast<uint8_t*>(image->bytes) : memory;
+  // private 4 KB repeats over the table, as instructions wrap there
+  auto size = std::min<uint32_t>(image ? XOCHIP_MEMORY_SIZE : capacity,
+                                 XOCHIP_MEMORY_SIZE);
+  for (auto page = 0; page < CHIP8_PAGES; page++) {
+    pages[page] = base + page * CHIP8_PAGE_SIZE % size;
+  }
+  memset(owned, image ? 0 : 0xff, sizeof(owned));
+}
+
+void Chip8Machine::own(uint32_t page) {
+  uint8_t* copy = nullptr;
+  for (auto& entry : copies) {
+    if (entry.first == page) {
+      copy = entry.second.get();
+    }
+  }
+  if (!copy) {
+    copies.emplace_back(page, new uint8_t[CHIP8_PAGE_SIZE]);
+    copy = copies.back().second.get();
+  }
+  memcpy(copy, pages[page], CHIP8_PAGE_SIZE);
+  pages[page] = copy;
+  owned[page >> 6] |= 1ull << (page & 63);
+}
+
+shared_ptr<const Chip8MemoryImage> Chip8Machine::snapshotMemory() const {
+  auto snapshot = std::make_shared<Chip8MemoryImage>();
+  for (auto page = 0; page < CHIP8_PAGES; page++) {
+    memcpy(snapshot->bytes + page * CHIP8_PAGE_SIZE, pages[page],
+           CHIP8_PAGE_SIZE);
+  }
+  return snapshot;
+}
+
+bool Chip8Machine::shareMemory(const shared_ptr<const Chip8MemoryImage>& from) {
+  if (capacity > XOCHIP_MEMORY_SIZE || !from) {
+    return false;
+  }
+  image = from;
+  storage.reset();
+  memory = nullptr;
+  mapPages();
+  memoryHash = 0;
+  return true;
+}
+
+uint32_t Chip8Machine::ownedPages() const {
+  uint32_t count = 0;
+  for (auto word : owned) {
+    count += std::bitset<64>(word).count();
+  }
+  return count;
+}
+
+// A machine sharing an image is copied by sharing that image too, only the
+// pages the source wrote are copied. Private machines copy all of memory.
+void Chip8Machine::copyState(const Chip8Machine& source) {
+  if (source.image && capacity <= XOCHIP_MEMORY_SIZE) {
+    if (image != source.image) {
+      image = source.image;
+      storage.reset();
+      memory = nullptr;
+    }
+    memcpy(pages, source.pages, sizeof(pages));
+    memset(owned, 0, sizeof(owned));
+    for (auto word = 0; word < CHIP8_PAGES / 64; word++) {
+      for (auto bits = source.owned[word]; bits; bits &= bits - 1) {
+        auto bit = std::bitset<64>((bits & -bits) - 1).count();
+        own(word * 64 + bit);
+      }
+    }
+  } else if (memory && source.memory) {
+    memcpy(memory, source.memory, std::min(capacity, source.capacity));
+  } else {
+    for (auto page = 0; page < CHIP8_PAGES; page++) {
+      if (!((owned[page >> 6] >> (page & 63)) & 1)) {
+        own(page);
+      }
+      memcpy(pages[page], source.pages[page], CHIP8_PAGE_SIZE);
+    }
+  }
+  memcpy(&screen, &source.screen, sizeof(screen));
+  hashing = source.hashing;
+  memoryHash = source.memoryHash;
+  memcpy(planeHash, source.planeHash, sizeof(planeHash));
+  randomState = source.randomState;
+  if (mega && source.mega) {
+    *mega = *source.mega;
+  }
+  memcpy(registers, source.registers, sizeof(registers));
+  memcpy(flags, source.flags, sizeof(flags));
+  memcpy(stack, source.stack, sizeof(stack));
+  memcpy(keyboard, source.keyboard, sizeof(keyboard));
+  sp = source.sp;
+  pc = source.pc;
+  index = source.index;
+  delayTimer = source.delayTimer;
+  soundTimer = source.soundTimer;
+  memcpy(pattern, source.pattern, sizeof(pattern));
+  pitch = source.pitch;
+  audioPattern = source.audioPattern;
+  instruction = source.instruction;
+  exited = source.exited;
+}
+
+bool Chip8Machine::forkInto(Chip8Machine& slot) const {
+  if (&slot == this || slot.profile() != profile()) {
+    return false;
+  }
+  slot.copyState(*this);
+  return true;
+}
+
+unique_ptr<Chip8Machine> Chip8Machine::clone() const {
+  auto copy = create(profile());
+  copy->copyState(*this);
+  return copy;
+}
+
+void Chip8Machine::enableStateHash() {
+  hashing = true;
+  memoryHash = 0;
+  hashScreen();
+}
+
+void Chip8Machine::seedRandom(uint64_t seed) {
+  // xorshift never leaves zero, which also means unseeded
+  auto state = hashWord(0, seed);
+  randomState = state ? state : 1;
+}
+
+void Chip8Machine::hashScreen() {
+  if (!hashing) {
+    return;
+  }
+  for (auto plane = 0; plane < XOCHIP_PLANES; plane++) {
+    planeHash[plane] = 0;
+    for (auto row = 0; row < CHIP8_HIRES_HEIGHT; row++) {
+      for (auto word = 0; word < CHIP8_ROW_WORDS; word++) {
+        auto position = CHIP8_HASH_VIDEO +
+                        (plane * CHIP8_HIRES_HEIGHT + row) * CHIP8_ROW_WORDS +
+                        word;
+        planeHash[plane] ^=
+            hashWord(position, screen.planes[plane][row][word]);
+      }
+    }
+  }
+}
+
+// About a hundred bytes of CPU state, folded 64 bits at a time.
+uint64_t Chip8Machine::stateHash() const {
+  uint64_t words[15];
+  memcpy(words, registers, 16);
+  memcpy(words + 2, keyboard, 16);
+  memcpy(words + 4, stack, 32);
+  memcpy(words + 8, flags, 16);
+  memcpy(words + 10, pattern, 16);
+  words[12] = uint64_t(pc) | uint64_t(index) << 16 | uint64_t(sp) << 48 |
+              uint64_t(delayTimer) << 56;
+  words[13] = uint64_t(soundTimer) | uint64_t(pitch) << 8 |
+              uint64_t(screen.selected) << 16 | uint64_t(screen.hires) << 24 |
+              uint64_t(exited) << 32 | uint64_t(audioPattern) << 40;
+  words[14] = randomState;
+  auto hash = memoryHash ^ planeHash[0] ^ planeHash[1];
+  for (uint32_t i = 0; i < 15; i++) {
+    hash = hashWord(i, hash ^ words[i]);
+  }
+  return hash;
+}
+
+void Chip8Machine::tickTimers() {
+  if (delayTimer > 0) {
+    delayTimer--;
+  }
+  if (soundTimer > 0) {
+    soundTimer--;
+  }
+}
+
+template <typename Quirks>
+Chip8Profile Chip8<Quirks>::profile() const {
+  return Quirks::profile;
+}
+
+template <typename Quirks>
+Chip8<Quirks>::Chip8(const shared_ptr<const Chip8MemoryImage>& image)
+    : Chip8Machine(Quirks::memorySize, image) {
+  if constexpr (Quirks::megaChip) {
+    mega = make_unique<MegaChipScreen>();
+    mega->reset();
+  }
+}
+
+template <typename Quirks>
+uint32_t Chip8<Quirks>::memorySize() const {
+  return Quirks::memorySize;
+}
+
+// MegaChip addresses 16 MB and never shares pages, it keeps flat memory.
+// Addresses wrap at the profile's memory size.
+template <typename Quirks>
+uint8_t Chip8<Quirks>::load(uint32_t address) const {
+  address &= Quirks::memorySize - 1;
+  if constexpr (Quirks::megaChip) {
+    return memory[address];
+  }
+  return read(address);
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::store(uint32_t address, uint8_t value) {
+  address &= Quirks::memorySize - 1;
+  if constexpr (Quirks::megaChip) {
+    memory[address] = value;
+    return;
+  }
+  write(address, value);
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::execute() {
+  step();
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::runFrame(uint32_t cycles) {
+  tickTimers();
+  for (uint32_t cycle = 0; cycle < cycles; cycle++) {
+    step();
+  }
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::step() {
+  // private memory is flat; shared pages hold both bytes unless pc is the
+  // last byte of one
+  auto address = pc & (Quirks::memorySize - 1);
+  auto next = (address + 1) & (Quirks::memorySize - 1);
+  auto offset = address & (CHIP8_PAGE_SIZE - 1);
+  if (memory) {
+    instruction = (memory[address] << 8) | memory[next];
+  } else if (offset != CHIP8_PAGE_SIZE - 1) {
+    auto bytes = pages[address >> CHIP8_PAGE_BITS] + offset;
+    instruction = (bytes[0] << 8) | bytes[1];
+  } else {
+    instruction = (read(address) << 8) | read(next);
+  }
   pc += 2;
   auto opcode = (instruction & 0xf000) >> 12;
   switch (opcode) {
@@ -89,9 +480,65 @@ void Chip8::execute() {
   }
 }
 
-void Chip8::opcode0x0() {
+// Skips the next instruction, F000 nnnn is four bytes long on XO-CHIP.
+template <typename Quirks>
+void Chip8<Quirks>::skip() {
+  if constexpr (Quirks::xoChip) {
+    if (load(pc) == 0xf0 && load(pc + 1) == 0x00) {
+      pc += 2;
+    }
+  }
+  pc += 2;
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x0() {
   auto op34 = instruction & 0xff;
 
+  if constexpr (Quirks::megaChip) {
+    switch (instruction & 0xff00) {
+      case 0x0100:
+        opcode0x01nn();
+        return;
+      case 0x0200:
+        opcode0x02nn();
+        return;
+      case 0x0300:
+        opcode0x03nn();
+        return;
+      case 0x0400:
+        opcode0x04nn();
+        return;
+      case 0x0500:
+        opcode0x05nn();
+        return;
+      case 0x0600:
+      case 0x0700:
+        // digitised sound is not supported
+        return;
+      case 0x0800:
+        opcode0x080n();
+        return;
+      case 0x0900:
+        opcode0x09nn();
+        return;
+      default:
+        break;
+    }
+    if (instruction == 0x0010) {
+      opcode0x0010();
+      return;
+    }
+    if (instruction == 0x0011) {
+      opcode0x0011();
+      return;
+    }
+    if ((instruction & 0xfff0) == 0x00b0) {
+      opcode0x00bn();
+      return;
+    }
+  }
+
   switch (op34) {
     case 0xe0:
       opcode0x0e0();
@@ -100,60 +547,308 @@ void Chip8::opcode0x0() {
       opcode0x0ee();
       break;
     default:
+      if constexpr (Quirks::superChip) {
+        switch (op34) {
+          case 0xfb:
+            opcode0x0fb();
+            break;
+          case 0xfc:
+            opcode0x0fc();
+            break;
+          case 0xfd:
+            opcode0x0fd();
+            break;
+          case 0xfe:
+            opcode0x0fe();
+            break;
+          case 0xff:
+            opcode0x0ff();
+            break;
+          default:
+            if ((op34 & 0xf0) == 0xc0) {
+              opcode0x00cn();
+            } else if (Quirks::xoChip && (op34 & 0xf0) == 0xd0) {
+              opcode0x00dn();
+            }
+            break;
+        }
+      }
       break;
   }
 }
 
-void Chip8::opcode0x0e0() { memset(video, 0, sizeof(video)); }
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x00cn() {
+  auto n = instruction & 0x000f;
+  auto height = screen.height();
+  for (auto plane = 0; plane < XOCHIP_PLANES; plane++) {
+    if (screen.selected & (1 << plane)) {
+      auto rows = screen.planes[plane];
+      memmove(rows[n], rows[0], (height - n) * sizeof(rows[0]));
+      memset(rows[0], 0, n * sizeof(rows[0]));
+    }
+  }
+  screen.dirty = ~0ull;
+  hashScreen();
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x00dn() {
+  auto n = instruction & 0x000f;
+  auto height = screen.height();
+  for (auto plane = 0; plane < XOCHIP_PLANES; plane++) {
+    if (screen.selected & (1 << plane)) {
+      auto rows = screen.planes[plane];
+      memmove(rows[0], rows[n], (height - n) * sizeof(rows[0]));
+      memset(rows[height - n], 0, n * sizeof(rows[0]));
+    }
+  }
+  screen.dirty = ~0ull;
+  hashScreen();
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x0fb() {
+  auto height = screen.height();
+  for (auto plane = 0; plane < XOCHIP_PLANES; plane++) {
+    if (!(screen.selected & (1 << plane))) {
+      continue;
+    }
+    auto rows = screen.planes[plane];
+    if (screen.hires) {
+      for (auto row = 0; row < height; row++) {
+        rows[row][1] = (rows[row][1] >> 4) | (rows[row][0] << 60);
+        rows[row][0] >>= 4;
+      }
+    } else {
+      for (auto row = 0; row < height; row++) {
+        rows[row][0] >>= 4;
+      }
+    }
+  }
+  screen.dirty = ~0ull;
+  hashScreen();
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x0fc() {
+  auto height = screen.height();
+  for (auto plane = 0; plane < XOCHIP_PLANES; plane++) {
+    if (!(screen.selected & (1 << plane))) {
+      continue;
+    }
+    auto rows = screen.planes[plane];
+    if (screen.hires) {
+      for (auto row = 0; row < height; row++) {
+        rows[row][0] = (rows[row][0] << 4) | (rows[row][1] >> 60);
+        rows[row][1] <<= 4;
+      }
+    } else {
+      for (auto row = 0; row < height; row++) {
+        rows[row][0] <<= 4;
+      }
+    }
+  }
+  screen.dirty = ~0ull;
+  hashScreen();
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x0fd() {
+  // spin on the exit instruction, the emulator stops on the flag
+  exited = true;
+  pc -= 2;
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x0fe() {
+  screen.hires = false;
+  memset(screen.planes, 0, sizeof(screen.planes));
+  screen.dirty = ~0ull;
+  memset(planeHash, 0, sizeof(planeHash));
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x0ff() {
+  screen.hires = true;
+  memset(screen.planes, 0, sizeof(screen.planes));
+  screen.dirty = ~0ull;
+  memset(planeHash, 0, sizeof(planeHash));
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x0010() {
+  mega->enabled = false;
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x0011() {
+  mega->enabled = true;
+  mega->clear();
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x00bn() {
+  if (mega->enabled) {
+    mega->scrollUp(instruction & 0x000f);
+  }
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x01nn() {
+  index = ((instruction & 0xff) << 16) | (load(pc) << 8) | load(pc + 1);
+  pc += 2;
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x02nn() {
+  auto count = instruction & 0xff;
+  if (index + 4 * count <= capacity) {
+    mega->loadPalette(memory + index, count);
+  }
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x03nn() {
+  auto width = instruction & 0xff;
+  mega->spriteWidth = width ? width : 256;
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x04nn() {
+  auto height = instruction & 0xff;
+  mega->spriteHeight = height ? height : 256;
+}
 
-void Chip8::opcode0x0ee() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x05nn() {
+  mega->alpha = instruction & 0xff;
+  mega->markAll();
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x080n() {
+  auto mode = instruction & 0x000f;
+  if (mode <= uint8_t(MegaChipBlend::Multiply)) {
+    mega->blend = MegaChipBlend(mode);
+  }
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x09nn() {
+  mega->collision = instruction & 0xff;
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x0e0() {
+  if constexpr (Quirks::megaChip) {
+    if (mega->enabled) {
+      mega->clear();
+      return;
+    }
+  }
+  for (auto plane = 0; plane < XOCHIP_PLANES; plane++) {
+    if (screen.selected & (1 << plane)) {
+      memset(screen.planes[plane], 0, sizeof(screen.planes[plane]));
+      planeHash[plane] = 0;
+    }
+  }
+  screen.dirty = ~0ull;
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x0ee() {
   sp--;
   pc = stack[sp];
 }
 
-void Chip8::opcode0x1() { pc = instruction & 0xfff; }
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x1() { pc = instruction & 0xfff; }
 
-void Chip8::opcode0x2() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x2() {
   stack[sp] = pc;
   sp++;
   pc = instruction & 0xfff;
 }
 
-void Chip8::opcode0x3() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x3() {
   auto x = (instruction & 0x0f00) >> 8;
   auto value = instruction & 0xff;
   if (registers[x] == value) {
-    pc += 2;
+    skip();
   }
 }
 
-void Chip8::opcode0x4() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x4() {
   auto x = (instruction & 0x0f00) >> 8;
   auto value = instruction & 0xff;
   if (registers[x] != value) {
-    pc += 2;
+    skip();
   }
 }
 
-void Chip8::opcode0x5() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x5() {
   auto x = (instruction & 0x0f00) >> 8;
   auto y = (instruction & 0x00f0) >> 4;
+  if constexpr (Quirks::xoChip) {
+    switch (instruction & 0x000f) {
+      case 0x2:
+        opcode0x5xy2();
+        return;
+      case 0x3:
+        opcode0x5xy3();
+        return;
+      default:
+        break;
+    }
+  }
   if (registers[x] == registers[y]) {
-    pc += 2;
+    skip();
+  }
+}
+
+// 5xy2/5xy3 store and load the Vx..Vy range, in reverse when x > y, and leave
+// I unchanged.
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x5xy2() {
+  auto x = (instruction & 0x0f00) >> 8;
+  auto y = (instruction & 0x00f0) >> 4;
+  auto count = (x < y ? y - x : x - y) + 1;
+  auto step = x < y ? 1 : -1;
+  for (auto i = 0; i < count; i++) {
+    store(uint16_t(index + i), registers[x + i * step]);
   }
 }
 
-void Chip8::opcode0x6() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x5xy3() {
+  auto x = (instruction & 0x0f00) >> 8;
+  auto y = (instruction & 0x00f0) >> 4;
+  auto count = (x < y ? y - x : x - y) + 1;
+  auto step = x < y ? 1 : -1;
+  for (auto i = 0; i < count; i++) {
+    registers[x + i * step] = load(uint16_t(index + i));
+  }
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x6() {
   auto x = (instruction & 0x0f00) >> 8;
   registers[x] = instruction & 0xff;
 }
 
-void Chip8::opcode0x7() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x7() {
   auto x = (instruction & 0x0f00) >> 8;
   registers[x] += instruction & 0xff;
 }
 
-void Chip8::opcode0x8() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x8() {
   auto op4 = instruction & 0xf;
   switch (op4) {
     case 0x1:
@@ -185,25 +880,38 @@ void Chip8::opcode0x8() {
   }
 }
 
-void Chip8::opcode0x8xy1() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x8xy1() {
   auto x = (instruction & 0x0f00) >> 8;
   auto y = (instruction & 0x00f0) >> 4;
   registers[x] |= registers[y];
+  if constexpr (Quirks::logicResetsVF) {
+    registers[0xf] = 0;
+  }
 }
 
-void Chip8::opcode0x8xy2() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x8xy2() {
   auto x = (instruction & 0x0f00) >> 8;
   auto y = (instruction & 0x00f0) >> 4;
   registers[x] &= registers[y];
+  if constexpr (Quirks::logicResetsVF) {
+    registers[0xf] = 0;
+  }
 }
 
-void Chip8::opcode0x8xy3() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x8xy3() {
   auto x = (instruction & 0x0f00) >> 8;
   auto y = (instruction & 0x00f0) >> 4;
   registers[x] ^= registers[y];
+  if constexpr (Quirks::logicResetsVF) {
+    registers[0xf] = 0;
+  }
 }
 
-void Chip8::opcode0x8xy4() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x8xy4() {
   auto x = (instruction & 0x0f00) >> 8;
   auto y = (instruction & 0x00f0) >> 4;
   int16_t sum = registers[x] + registers[y];
@@ -216,7 +924,8 @@ void Chip8::opcode0x8xy4() {
   registers[x] += registers[y];
 }
 
-void Chip8::opcode0x8xy5() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x8xy5() {
   auto x = (instruction & 0x0f00) >> 8;
   auto y = (instruction & 0x00f0) >> 4;
   uint8_t result = registers[x] - registers[y];
@@ -229,13 +938,17 @@ void Chip8::opcode0x8xy5() {
   registers[x] -= registers[y];
 }
 
-void Chip8::opcode0x8xy6() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x8xy6() {
   auto x = (instruction & 0x0f00) >> 8;
-  registers[0xf] = registers[x] & 0x01;
-  registers[x] >>= 1;
+  auto y = (instruction & 0x00f0) >> 4;
+  auto value = Quirks::shiftUsesVy ? registers[y] : registers[x];
+  registers[x] = value >> 1;
+  registers[0xf] = value & 0x01;
 }
 
-void Chip8::opcode0x8xy7() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x8xy7() {
   auto x = (instruction & 0x0f00) >> 8;
   auto y = (instruction & 0x00f0) >> 4;
   uint8_t result = registers[x] - registers[y];
@@ -248,61 +961,150 @@ void Chip8::opcode0x8xy7() {
   registers[x] = registers[y] - registers[x];
 }
 
-void Chip8::opcode0x8xye() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x8xye() {
   auto x = (instruction & 0x0f00) >> 8;
-  registers[0xf] = (registers[x] & 0x80) >> 7;
-  registers[x] <<= 1;
+  auto y = (instruction & 0x00f0) >> 4;
+  auto value = Quirks::shiftUsesVy ? registers[y] : registers[x];
+  registers[x] = value << 1;
+  registers[0xf] = (value & 0x80) >> 7;
 }
 
-void Chip8::opcode0x9() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0x9() {
   auto x = (instruction & 0x0f00) >> 8;
   auto y = (instruction & 0x00f0) >> 4;
   if (registers[y] != registers[x]) {
-    pc += 2;
+    skip();
   }
 }
 
-void Chip8::opcode0xa() { index = instruction & 0x0fff; }
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xa() { index = instruction & 0x0fff; }
 
-void Chip8::opcode0xb() { index = registers[0] + (instruction & 0x0fff); }
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xb() {
+  if constexpr (Quirks::jumpUsesVx) {
+    auto x = (instruction & 0x0f00) >> 8;
+    pc = registers[x] + (instruction & 0x0fff);
+  } else {
+    pc = registers[0] + (instruction & 0x0fff);
+  }
+}
 
-void Chip8::opcode0xc() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xc() {
   auto x = (instruction & 0x0f00) >> 8;
   auto value = instruction & 0xff;
-  auto r = rand() % 256;
-  registers[x] = r & value;
+  registers[x] = nextRandom() & value;
 }
 
-void Chip8::opcode0xd() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xd() {
   auto x = (instruction & 0x0f00) >> 8;
   auto y = (instruction & 0x00f0) >> 4;
   auto n = instruction & 0x000f;
 
-  uint8_t posx = registers[x] % CHIP8_VIDEO_WIDTH;
-  uint8_t posy = registers[y] % CHIP8_VIDEO_HEIGHT;
+  if constexpr (Quirks::megaChip) {
+    if (mega->enabled) {
+      // sprite rows past the end of memory are not drawn
+      uint32_t width = mega->spriteWidth;
+      uint32_t height = mega->spriteHeight;
+      if (width && index + width * height > capacity) {
+        height = (capacity - index) / width;
+      }
+      registers[0xF] = mega->blit(memory + index, width, height, registers[x],
+                                  registers[y]);
+      return;
+    }
+  }
+
+  // screen sizes are powers of two
+  uint8_t posx = registers[x] & (screen.width() - 1);
+  uint8_t posy = registers[y] & (screen.height() - 1);
 
   registers[0xF] = 0;
 
+  // each selected plane reads the next sprite in memory
+  uint16_t address = index;
+  for (auto plane = 0; plane < XOCHIP_PLANES; plane++) {
+    if (!(screen.selected & (1 << plane))) {
+      continue;
+    }
+    if (Quirks::superChip && n == 0) {
+      draw<16>(plane, address, posx, posy, 16);
+      address += 32;
+    } else {
+      draw<8>(plane, address, posx, posy, n);
+      address += n;
+    }
+  }
+}
+
+// Sprite rows are aligned to the top of a 64-bit word and shifted into place,
+// so a whole sprite row is tested and XORed with one or two word operations.
+template <typename Quirks>
+template <int width>
+void Chip8<Quirks>::draw(uint8_t plane, uint16_t address, uint8_t posx,
+                         uint8_t posy, uint8_t n) {
+  auto height = screen.height();
+  auto hires = screen.hires;
+  auto rows = screen.planes[plane];
+
   for (auto row = 0; row < n; row++) {
-    auto byte = memory[index + row];
+    uint64_t bits;
+    if constexpr (width == 16) {
+      uint16_t line = address + 2 * row;
+      bits = uint64_t((load(line) << 8) | load(uint16_t(line + 1))) << 48;
+    } else {
+      bits = uint64_t(load(uint16_t(address + row))) << 56;
+    }
 
-    for (unsigned int col = 0; col < 8; col++) {
-      auto sprite = byte & (0x80 >> col);
-      auto position = (posy + row) * CHIP8_VIDEO_WIDTH + (posx + col);
-      auto screen = video[position];
+    auto line = posy + row;
+    if constexpr (Quirks::clipSprites) {
+      if (line >= height) {
+        break;
+      }
+    } else {
+      line &= height - 1;
+    }
+    auto& words = rows[line];
+    if (bits) {
+      screen.dirty |= 1ull << line;
+    }
 
-      if (sprite) {
-        if (screen == 0xffffffff) {
-          registers[0xF] = 1;
-        }
+    // pixels pushed out of the right edge
+    auto offset = posx & 63;
+    uint64_t spill = offset ? bits << (64 - offset) : 0;
+    uint64_t first = bits >> offset;
 
-        video[position] ^= 0xffffffff;
+    if (!hires) {
+      if constexpr (!Quirks::clipSprites) {
+        first |= spill;
+      }
+      if (words[0] & first) {
+        registers[0xF] = 1;
       }
+      flipWord(plane, line, 0, first);
+      continue;
     }
+
+    uint64_t left = first;
+    uint64_t right = spill;
+    if (posx >= 64) {
+      left = Quirks::clipSprites ? 0 : spill;
+      right = first;
+    }
+    if ((words[0] & left) | (words[1] & right)) {
+      registers[0xF] = 1;
+    }
+    flipWord(plane, line, 0, left);
+    flipWord(plane, line, 1, right);
   }
 }
 
-void Chip8::opcode0xe() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xe() {
   auto op34 = instruction & 0xff;
   switch (op34) {
     case 0x9e:
@@ -316,24 +1118,49 @@ void Chip8::opcode0xe() {
   }
 }
 
-void Chip8::opcode0xex9e() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xex9e() {
   auto x = (instruction & 0xf00) >> 8;
   auto key = registers[x];
   if (keyboard[key]) {
-    pc += 2;
+    skip();
   }
 }
 
-void Chip8::opcode0xexa1() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xexa1() {
   auto x = (instruction & 0xf00) >> 8;
   auto key = registers[x];
   if (!keyboard[key]) {
-    pc += 2;
+    skip();
   }
 }
 
-void Chip8::opcode0xf() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xf() {
   auto op34 = instruction & 0xff;
+  if constexpr (Quirks::xoChip) {
+    switch (instruction) {
+      case 0xf000:
+        opcode0xf000();
+        return;
+      case 0xf002:
+        opcode0xf002();
+        return;
+      default:
+        break;
+    }
+    switch (op34) {
+      case 0x01:
+        opcode0xfn01();
+        return;
+      case 0x3a:
+        opcode0xfx3a();
+        return;
+      default:
+        break;
+    }
+  }
   switch (op34) {
     case 0x07:
       opcode0xfx07();
@@ -353,6 +1180,11 @@ void Chip8::opcode0xf() {
     case 0x29:
       opcode0xfx29();
       break;
+    case 0x30:
+      if constexpr (Quirks::superChip) {
+        opcode0xfx30();
+      }
+      break;
     case 0x33:
       opcode0xfx33();
       break;
@@ -361,17 +1193,49 @@ void Chip8::opcode0xf() {
       break;
     case 0x65:
       opcode0xfx65();
+      break;
+    case 0x75:
+      if constexpr (Quirks::superChip) {
+        opcode0xfx75();
+      }
+      break;
+    case 0x85:
+      if constexpr (Quirks::superChip) {
+        opcode0xfx85();
+      }
+      break;
     default:
       break;
   }
 }
 
-void Chip8::opcode0xfx07() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xf000() {
+  index = (load(pc) << 8) | load(uint16_t(pc + 1));
+  pc += 2;
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfn01() {
+  screen.selected = (instruction & 0xf00) >> 8;
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xf002() {
+  for (auto i = 0; i < XOCHIP_PATTERN; i++) {
+    pattern[i] = load(uint16_t(index + i));
+  }
+  audioPattern = true;
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx07() {
   auto x = (instruction & 0xf00) >> 8;
   registers[x] = delayTimer;
 }
 
-void Chip8::opcode0xfx0a() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx0a() {
   auto x = (instruction & 0xf00) >> 8;
   for (auto i = 0; i < CHIP8_KEYS; i++) {
     if (keyboard[i]) {
@@ -382,47 +1246,91 @@ void Chip8::opcode0xfx0a() {
   pc -= 2;
 }
 
-void Chip8::opcode0xfx15() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx15() {
   auto x = (instruction & 0xf00) >> 8;
   delayTimer = registers[x];
 }
 
-void Chip8::opcode0xfx18() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx18() {
   auto x = (instruction & 0xf00) >> 8;
   soundTimer = registers[x];
 }
 
-void Chip8::opcode0xfx1e() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx1e() {
   auto x = (instruction & 0xf00) >> 8;
-  index += registers[x];
+  index = (index + registers[x]) & (Quirks::memorySize - 1);
 }
 
-void Chip8::opcode0xfx29() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx29() {
   auto x = (instruction & 0xf00) >> 8;
   auto digit = registers[x];
   index = CHIP8_FONTS_START + (digit * CHIP8_FONT_SIZE);
 }
 
-void Chip8::opcode0xfx33() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx30() {
+  auto x = (instruction & 0xf00) >> 8;
+  auto digit = registers[x] & 0xf;
+  index = CHIP8_BIG_FONTS_START + (digit * CHIP8_BIG_FONT_SIZE);
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx33() {
   auto x = (instruction & 0xf00) >> 8;
   auto value = registers[x];
-  memory[index + 2] = value % 10;
+  store(index + 2, value % 10);
   value /= 10;
-  memory[index + 1] = value % 10;
+  store(index + 1, value % 10);
   value /= 10;
-  memory[index] = value % 10;
+  store(index, value % 10);
 }
 
-void Chip8::opcode0xfx55() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx55() {
   auto x = (instruction & 0xf00) >> 8;
   for (auto i = 0; i <= x; i++) {
-    memory[index + i] = registers[i];
+    store(index + i, registers[i]);
+  }
+  if constexpr (Quirks::incrementsIndex) {
+    index = (index + x + 1) & (Quirks::memorySize - 1);
   }
 }
 
-void Chip8::opcode0xfx65() {
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx65() {
   auto x = (instruction & 0xf00) >> 8;
   for (auto i = 0; i <= x; i++) {
-    memory[index + i] = registers[i];
+    registers[i] = load(index + i);
+  }
+  if constexpr (Quirks::incrementsIndex) {
+    index = (index + x + 1) & (Quirks::memorySize - 1);
   }
 }
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx3a() {
+  auto x = (instruction & 0xf00) >> 8;
+  pitch = registers[x];
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx75() {
+  auto x = (instruction & 0xf00) >> 8;
+  memcpy(flags, registers, x + 1);
+}
+
+template <typename Quirks>
+void Chip8<Quirks>::opcode0xfx85() {
+  auto x = (instruction & 0xf00) >> 8;
+  memcpy(registers, flags, x + 1);
+}
+
+template class Chip8<ModernQuirks>;
+template class Chip8<CosmacQuirks>;
+template class Chip8<SuperChipQuirks>;
+template class Chip8<XoChipQuirks>;
+template class Chip8<MegaChipQuirks>;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "megachip.hpp"
 #include "pch.h"
 
 #define CHIP8_MEMORY_SIZE 4096
@@ -9,49 +10,338 @@
 #define CHIP8_FONTS 16
 #define CHIP8_FONT_SIZE 0x05
 #define CHIP8_FONTS_START 0x50
+#define CHIP8_BIG_FONT_SIZE 0x0a
+#define CHIP8_BIG_FONTS_START 0xa0
 #define CHIP8_STACK 16
 #define CHIP8_VIDEO_HEIGHT 32
 #define CHIP8_VIDEO_WIDTH 64
+#define CHIP8_HIRES_HEIGHT 64
+#define CHIP8_HIRES_WIDTH 128
+#define CHIP8_ROW_WORDS (CHIP8_HIRES_WIDTH / 64)
+#define CHIP8_FLAGS 16
+#define XOCHIP_MEMORY_SIZE 0x10000
+#define XOCHIP_PLANES 2
+#define XOCHIP_PATTERN 16
+#define XOCHIP_PITCH 64
+#define CHIP8_DIRTY_WORDS MEGACHIP_DIRTY_WORDS
+#define CHIP8_PAGE_BITS 8
+#define CHIP8_PAGE_SIZE (1 << CHIP8_PAGE_BITS)
+#define CHIP8_PAGES (XOCHIP_MEMORY_SIZE / CHIP8_PAGE_SIZE)
+#define CHIP8_HASH_VIDEO XOCHIP_MEMORY_SIZE
 
+using std::shared_ptr;
+using std::unique_ptr;
 using std::vector;
 
-class Chip8 {
+enum class Chip8Profile { Modern, Cosmac, SuperChip, XoChip, MegaChip };
+
+// Quirk policies, resolved at compile time by Chip8<Quirks>.
+//   shiftUsesVy:     8xy6/8xyE shift Vy into Vx instead of shifting Vx
+//   incrementsIndex: Fx55/Fx65 leave I pointing past the last register
+//   logicResetsVF:   8xy1/8xy2/8xy3 clear VF
+//   jumpUsesVx:      Bxnn jumps to xnn + Vx instead of Bnnn to nnn + V0
+//   clipSprites:     sprites are clipped at the screen edges, not wrapped
+//   superChip:       SUPER-CHIP 1.1 hi-res, scrolling, Dxy0, Fx30, Fx75/Fx85
+//   xoChip:          XO-CHIP 64 KB memory, bitplanes, 00Dn, 5xy2/5xy3,
+//                    F000 nnnn, Fn01, F002, Fx3A
+//   megaChip:        MegaChip 256x192 indexed colour mode, 01nn nnnn, 02nn-09nn
+//   memorySize:      addressable memory, the ROM size limit
+struct ModernQuirks {
+  static constexpr Chip8Profile profile = Chip8Profile::Modern;
+  static constexpr bool shiftUsesVy = false;
+  static constexpr bool incrementsIndex = false;
+  static constexpr bool logicResetsVF = false;
+  static constexpr bool jumpUsesVx = false;
+  static constexpr bool clipSprites = true;
+  static constexpr bool superChip = false;
+  static constexpr bool xoChip = false;
+  static constexpr bool megaChip = false;
+  static constexpr uint32_t memorySize = CHIP8_MEMORY_SIZE;
+};
+
+struct CosmacQuirks {
+  static constexpr Chip8Profile profile = Chip8Profile::Cosmac;
+  static constexpr bool shiftUsesVy = true;
+  static constexpr bool incrementsIndex = true;
+  static constexpr bool logicResetsVF = true;
+  static constexpr bool jumpUsesVx = false;
+  static constexpr bool clipSprites = true;
+  static constexpr bool superChip = false;
+  static constexpr bool xoChip = false;
+  static constexpr bool megaChip = false;
+  static constexpr uint32_t memorySize = CHIP8_MEMORY_SIZE;
+};
+
+struct SuperChipQuirks {
+  static constexpr Chip8Profile profile = Chip8Profile::SuperChip;
+  static constexpr bool shiftUsesVy = false;
+  static constexpr bool incrementsIndex = false;
+  static constexpr bool logicResetsVF = false;
+  static constexpr bool jumpUsesVx = true;
+  static constexpr bool clipSprites = true;
+  static constexpr bool superChip = true;
+  static constexpr bool xoChip = false;
+  static constexpr bool megaChip = false;
+  static constexpr uint32_t memorySize = CHIP8_MEMORY_SIZE;
+};
+
+struct XoChipQuirks {
+  static constexpr Chip8Profile profile = Chip8Profile::XoChip;
+  static constexpr bool shiftUsesVy = true;
+  static constexpr bool incrementsIndex = true;
+  static constexpr bool logicResetsVF = false;
+  static constexpr bool jumpUsesVx = false;
+  static constexpr bool clipSprites = false;
+  static constexpr bool superChip = true;
+  static constexpr bool xoChip = true;
+  static constexpr bool megaChip = false;
+  static constexpr uint32_t memorySize = XOCHIP_MEMORY_SIZE;
+};
+
+struct MegaChipQuirks {
+  static constexpr Chip8Profile profile = Chip8Profile::MegaChip;
+  static constexpr bool shiftUsesVy = false;
+  static constexpr bool incrementsIndex = false;
+  static constexpr bool logicResetsVF = false;
+  static constexpr bool jumpUsesVx = true;
+  static constexpr bool clipSprites = true;
+  static constexpr bool superChip = true;
+  static constexpr bool xoChip = false;
+  static constexpr bool megaChip = true;
+  static constexpr uint32_t memorySize = MEGACHIP_MEMORY_SIZE;
+};
+
+// Packed framebuffer, one bit per pixel and one bitmap per plane. Each row is
+// CHIP8_ROW_WORDS words with the leftmost pixel in the most significant bit of
+// the first word. Lo-res (64x32) only uses the first word of the first 32
+// rows. Only XO-CHIP selects the second plane.
+struct alignas(64) Chip8Screen {
+  uint64_t planes[XOCHIP_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS];
+  uint8_t selected;
+  bool hires;
+  // bit n is set when row n changed since the last present
+  uint64_t dirty;
+
+  uint16_t width() const {
+    return hires ? CHIP8_HIRES_WIDTH : CHIP8_VIDEO_WIDTH;
+  }
+  uint16_t height() const {
+    return hires ? CHIP8_HIRES_HEIGHT : CHIP8_VIDEO_HEIGHT;
+  }
+  // colour index, bit n is set by plane n
+  uint8_t pixel(uint16_t x, uint16_t y) const {
+    auto shift = 63 - (x & 63);
+    return ((planes[0][y][x >> 6] >> shift) & 1) |
+           (((planes[1][y][x >> 6] >> shift) & 1) << 1);
+  }
+};
+
+// Immutable 64 KB memory image (font and ROM) shared by machines running the
+// same program, see Chip8Machine::shareMemory().
+struct Chip8MemoryImage {
+  uint8_t bytes[XOCHIP_MEMORY_SIZE];
+};
+
+// Machine state shared by every quirk profile. Instructions are executed by
+// Chip8<Quirks>, use create() to pick the profile at run time.
+class Chip8Machine {
  private:
-  Chip8(const Chip8&) = delete;
-  Chip8& operator=(const Chip8&) = delete;
+  Chip8Machine(const Chip8Machine&) = delete;
+  Chip8Machine& operator=(const Chip8Machine&) = delete;
 
  public:
-  Chip8();
-  ~Chip8() = default;
+  // with an image the machine shares it from the start, see shareMemory(),
+  // and never allocates its own memory
+  Chip8Machine(uint32_t capacity,
+               const shared_ptr<const Chip8MemoryImage>& image = nullptr);
+  virtual ~Chip8Machine() = default;
+
+  static unique_ptr<Chip8Machine> create(Chip8Profile profile);
+  // constructs in place, place holds instanceSize() bytes aligned to 64
+  static Chip8Machine* createAt(
+      void* place, Chip8Profile profile,
+      const shared_ptr<const Chip8MemoryImage>& image = nullptr);
+  static size_t instanceSize(Chip8Profile profile);
+
+  virtual Chip8Profile profile() const = 0;
+  virtual void execute() = 0;
+  virtual void runFrame(uint32_t cycles) = 0;
+  virtual uint32_t memorySize() const = 0;
 
   void reset();
-  void execute();
+  void copyState(const Chip8Machine& source);
+  // Copies the state into slot, a preallocated machine of the same profile,
+  // or into a new machine. Both keep sharing the source's memory image.
+  bool forkInto(Chip8Machine& slot) const;
+  unique_ptr<Chip8Machine> clone() const;
+  // bytes this instance uses, its own heap memory included but not a shared
+  // memory image
+  size_t footprint() const;
+  // Memory is accessed through a table of CHIP8_PAGE_SIZE pages. A machine
+  // sharing an image reads its pages in place and copies a page on its first
+  // write; memory is null while sharing, reset() returns to the image. Not
+  // available for MegaChip, whose memory is larger than the table.
+  shared_ptr<const Chip8MemoryImage> snapshotMemory() const;
+  bool shareMemory(const shared_ptr<const Chip8MemoryImage>& image);
+  uint32_t ownedPages() const;
+  uint8_t read(uint32_t address) const {
+    return pages[(address >> CHIP8_PAGE_BITS) & (CHIP8_PAGES - 1)]
+                [address & (CHIP8_PAGE_SIZE - 1)];
+  }
+  void write(uint32_t address, uint8_t value) {
+    auto page = (address >> CHIP8_PAGE_BITS) & (CHIP8_PAGES - 1);
+    if (!((owned[page >> 6] >> (page & 63)) & 1)) {
+      own(page);
+    }
+    auto& byte = pages[page][address & (CHIP8_PAGE_SIZE - 1)];
+    if (hashing) {
+      memoryHash ^= hashWord(address, byte) ^ hashWord(address, value);
+    }
+    byte = value;
+  }
+
+  // Hash of the machine state, for deduplicating search states. Once enabled,
+  // memory and screen words are hashed as they are written, so only the CPU
+  // state is hashed by stateHash(). Memory is hashed relative to its content
+  // when enabled, at reset() or shareMemory() and only through write();
+  // MegaChip screens are not covered. Forks keep hashing.
+  void enableStateHash();
+  uint64_t stateHash() const;
+  // zero for a zero word, so cleared planes hash to zero
+  static uint64_t hashWord(uint32_t position, uint64_t word) {
+    word *= (uint64_t(position) << 1 | 1) * 0x9e3779b97f4a7c15ull;
+    word ^= word >> 33;
+    word *= 0xff51afd7ed558ccdull;
+    word ^= word >> 33;
+    word *= 0xc4ceb9fe1a85ec53ull;
+    return word ^ (word >> 33);
+  }
+  // Cxkk draws from rand() until seeded, then from a xorshift generator of
+  // the machine that forks copy, so a seeded run replays exactly.
+  void seedRandom(uint64_t seed);
   void setMemory(uint16_t start, const vector<uint8_t>& code);
-  void setVideo(uint16_t start, const vector<int32_t>& screen);
+  // flat memory is copied at once, shared or hashed memory through write()
+  void copyMemory(uint32_t address, const uint8_t* data, size_t size);
+  void setVideo(uint16_t start, const vector<int32_t>& pixels);
   void setStack(const vector<uint16_t>& addrs);
 
-  uint8_t memory[CHIP8_MEMORY_SIZE];
-  int32_t video[CHIP8_VIDEO_WIDTH * CHIP8_VIDEO_HEIGHT];
-  uint8_t registers[CHIP8_REGS];
-  uint16_t stack[CHIP8_STACK];
-  bool keyboard[CHIP8_KEYS];
-  uint8_t sp;
+  // Rows of the displayed screen changed since clearDirty(), bit n of word
+  // n / 64 for row n.
+  void dirtyRows(uint64_t* rows) const;
+  void markDirty(const uint64_t* rows);
+  void clearDirty();
+
+  // Hot CPU state first: with the vtable pointer it fills the first cache
+  // line, the stack and XO-CHIP state the second.
+  uint8_t* memory;
   uint16_t pc;
-  uint16_t index;
+  uint16_t instruction;
+  uint32_t index;
+  uint8_t sp;
   uint8_t delayTimer;
   uint8_t soundTimer;
+  bool exited;
+  uint8_t registers[CHIP8_REGS];
+  bool keyboard[CHIP8_KEYS];
+  uint8_t pitch;
+  bool audioPattern;
+  alignas(64) uint16_t stack[CHIP8_STACK];
+  uint8_t flags[CHIP8_FLAGS];
+  uint8_t pattern[XOCHIP_PATTERN];
+  Chip8Screen screen;
+  unique_ptr<MegaChipScreen> mega;
 
-  uint16_t instruction;
+ protected:
+  void tickTimers();
+  void own(uint32_t page);
+  void mapPages();
+  void hashScreen();
+  uint8_t nextRandom() {
+    if (!randomState) {
+      return rand() % 256;
+    }
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return (randomState * 0x2545f4914f6cdd1dull) >> 56;
+  }
+  void flipWord(uint8_t plane, uint32_t row, uint32_t word, uint64_t bits) {
+    auto& target = screen.planes[plane][row][word];
+    if (hashing && bits) {
+      auto position = CHIP8_HASH_VIDEO +
+                      (plane * CHIP8_HIRES_HEIGHT + row) * CHIP8_ROW_WORDS +
+                      word;
+      planeHash[plane] ^=
+          hashWord(position, target) ^ hashWord(position, target ^ bits);
+    }
+    target ^= bits;
+  }
+
+  // memorySize() bytes, a 4 KB profile's repeat over the page table
+  unique_ptr<uint8_t[]> storage;
+  uint32_t capacity;
+  uint8_t* pages[CHIP8_PAGES];
+  uint64_t owned[CHIP8_PAGES / 64];
+  shared_ptr<const Chip8MemoryImage> image;
+  // private copies of shared pages, kept for the next write to that page
+  vector<std::pair<uint32_t, unique_ptr<uint8_t[]>>> copies;
+  bool hashing = false;
+  uint64_t memoryHash;
+  uint64_t planeHash[XOCHIP_PLANES];
+  // zero until seedRandom()
+  uint64_t randomState = 0;
+};
 
+template <typename Quirks = ModernQuirks>
+class Chip8 : public Chip8Machine {
  private:
+  Chip8(const Chip8&) = delete;
+  Chip8& operator=(const Chip8&) = delete;
+
+ public:
+  explicit Chip8(const shared_ptr<const Chip8MemoryImage>& image = nullptr);
+  virtual ~Chip8() = default;
+
+  virtual Chip8Profile profile() const override;
+  virtual void execute() override;
+  virtual void runFrame(uint32_t cycles) override;
+  virtual uint32_t memorySize() const override;
+
+ protected:
+  uint8_t load(uint32_t address) const;
+  void store(uint32_t address, uint8_t value);
+  void step();
+  void skip();
+  template <int width>
+  void draw(uint8_t plane, uint16_t address, uint8_t posx, uint8_t posy,
+            uint8_t n);
   void opcode0x0();
+  void opcode0x00cn();
+  void opcode0x00dn();
   void opcode0x0e0();
   void opcode0x0ee();
+  void opcode0x0fb();
+  void opcode0x0fc();
+  void opcode0x0fd();
+  void opcode0x0fe();
+  void opcode0x0ff();
+  void opcode0x0010();
+  void opcode0x0011();
+  void opcode0x00bn();
+  void opcode0x01nn();
+  void opcode0x02nn();
+  void opcode0x03nn();
+  void opcode0x04nn();
+  void opcode0x05nn();
+  void opcode0x080n();
+  void opcode0x09nn();
   void opcode0x1();
   void opcode0x2();
   void opcode0x3();
   void opcode0x4();
   void opcode0x5();
+  void opcode0x5xy2();
+  void opcode0x5xy3();
   void opcode0x6();
   void opcode0x7();
   void opcode0x8();
@@ -72,13 +362,26 @@ class Chip8 {
   void opcode0xex9e();
   void opcode0xexa1();
   void opcode0xf();
+  void opcode0xf000();
+  void opcode0xfn01();
+  void opcode0xf002();
   void opcode0xfx07();
   void opcode0xfx0a();
   void opcode0xfx15();
   void opcode0xfx18();
   void opcode0xfx1e();
   void opcode0xfx29();
+  void opcode0xfx30();
   void opcode0xfx33();
+  void opcode0xfx3a();
   void opcode0xfx55();
   void opcode0xfx65();
-};
\ No newline at end of file
+  void opcode0xfx75();
+  void opcode0xfx85();
+};
+
+extern template class Chip8<ModernQuirks>;
+extern template class Chip8<CosmacQuirks>;
+extern template class Chip8<SuperChipQuirks>;
+extern template class Chip8<XoChipQuirks>;
+extern template class Chip8<MegaChipQuirks>;
@@ -0,0 +1,74 @@
+/* Shared-memory export of a running emulator, see Chip8SharedState.
+ *
+ * The segment holds one struct chip8_shm in native byte order. The emulator
+ * updates it after every emulated frame with a seqlock: sequence is odd while
+ * a write is in progress and advances by 2 per frame. Readers never block
+ * the emulator, they retry when the sequence changed under them:
+ *
+ *   uint64_t begin;
+ *   do {
+ *     begin = chip8_shm_begin(shm);
+ *     ... read fields in place ...
+ *   } while (chip8_shm_retry(shm, begin));
+ */
+#ifndef CHIP8_SHM_H
+#define CHIP8_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define CHIP8_SHM_MAGIC 0x4d485338u /* "8SHM" */
+#define CHIP8_SHM_VERSION 1
+
+enum chip8_shm_format { CHIP8_SHM_PLANES = 0, CHIP8_SHM_INDEXED = 1 };
+
+struct chip8_shm {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;    /* sizeof(struct chip8_shm) */
+  uint32_t profile; /* 0 modern, 1 cosmac, 2 schip, 3 xochip, 4 megachip */
+  uint64_t sequence;
+  uint64_t frame; /* emulated frames, 1/60 s each */
+  uint8_t registers[16];
+  uint16_t stack[16];
+  uint32_t index;
+  uint16_t pc;
+  uint8_t sp;
+  uint8_t delay_timer;
+  uint8_t sound_timer;
+  uint8_t format; /* enum chip8_shm_format */
+  uint16_t width;
+  uint16_t height;
+  uint16_t reserved;
+  /* bit planes, 2 words per row, the leftmost pixel in the high bit */
+  uint64_t planes[2][64][2];
+  /* MegaChip palette indices and RGBA palette, valid for CHIP8_SHM_INDEXED */
+  uint8_t indexed[192][256];
+  uint32_t palette[256];
+};
+
+static inline uint64_t chip8_shm_begin(const struct chip8_shm* shm) {
+  uint64_t sequence;
+  while ((sequence = __atomic_load_n(&shm->sequence, __ATOMIC_ACQUIRE)) & 1) {
+  }
+  return sequence;
+}
+
+/* non-zero when the fields read since chip8_shm_begin may be torn */
+static inline int chip8_shm_retry(const struct chip8_shm* shm,
+                                  uint64_t begin) {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&shm->sequence, __ATOMIC_RELAXED) != begin;
+}
+
+/* copies a consistent snapshot, for readers that want to keep one */
+static inline void chip8_shm_snapshot(const struct chip8_shm* shm,
+                                      struct chip8_shm* out) {
+  uint64_t begin;
+  do {
+    begin = chip8_shm_begin(shm);
+    memcpy(out, shm, sizeof(*out));
+  } while (chip8_shm_retry(shm, begin));
+}
+
+#endif
@@ -2,34 +2,241 @@
 
 #include "loader.hpp"
 
-using std::chrono::milliseconds;
+using std::make_unique;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
 using std::this_thread::sleep_for;
+using std::this_thread::sleep_until;
 
 Chip8Emulator::Chip8Emulator(Chip8HardwareManager* hm) : hardwareManager(hm) {
-  FontLoader fontLoader{};
-  fontLoader.loadFont(chip8);
+  audioReady = hardwareManager->openAudio(&audioRing);
 }
 
 Chip8Emulator ::~Chip8Emulator() { delete hardwareManager; }
 
 void Chip8Emulator::execute(const string& romfile) {
   ROMLoader romLoader{};
-  validROM = romLoader.loadROM(chip8, romfile);
+  validROM = romLoader.readROM(romfile);
   if (validROM) {
-    auto run = true;
-    while (run) {
-      chip8.execute();
-      hardwareManager->display(chip8.video);
-      run = hardwareManager->handleKeys(chip8.keyboard);
-
-      if (chip8.delayTimer > 0) {
-        chip8.delayTimer--;
-      }
-      if (chip8.soundTimer > 0) {
-        chip8.soundTimer--;
-      }
+    auto& rom = romLoader.info();
+    if (autoProfile) {
+      profile = rom.profile;
+      cyclesPerFrame = rom.cyclesPerFrame;
+      keymap = rom.keymap;
+    }
+
+    chip8 = Chip8Machine::create(profile);
+    ahead = Chip8Machine::create(profile);
+    speculator.reset();
+    if (speculation > 0) {
+      speculator = make_unique<Chip8Speculator>(profile, speculation);
+    }
+
+    FontLoader fontLoader{};
+    fontLoader.loadFont(*chip8);
+    validROM = romLoader.copyROM(*chip8);
+    if (!validROM) {
+      return;
+    }
+    // run-ahead and speculation fork the machine every frame, with a shared
+    // image a fork copies only the pages the program wrote. Forks copy the
+    // machine's Cxkk generator, so the frames they run draw the same random
+    // values the machine will and leave its sequence alone.
+    if (runAhead > 0 || speculation > 0) {
+      chip8->shareMemory(chip8->snapshotMemory());
+      chip8->seedRandom(std::random_device{}());
+    }
+
+    // without an audio device there is no clock to follow
+    if (sync == Chip8Sync::Audio && audioReady) {
+      runAudio();
+    } else {
+      runDeadline();
+    }
+  }
+}
+
+void Chip8Emulator::setProfile(Chip8Profile quirks) {
+  profile = quirks;
+  autoProfile = false;
+}
+
+void Chip8Emulator::setSync(Chip8Sync mode) { sync = mode; }
+
+void Chip8Emulator::setRunAhead(uint32_t frames) {
+  runAhead = frames;
+  stats.latencySaved = frames * 1000.0 / CHIP8_FRAME_RATE;
+}
+
+void Chip8Emulator::setMaxFrameSkip(uint32_t frames) {
+  maxFrameSkip = frames;
+}
+
+void Chip8Emulator::setSpeculation(uint32_t threads) { speculation = threads; }
+
+void Chip8Emulator::setPalette(const Chip8Palette& palette) {
+  presenter.setPalette(palette);
+}
+
+void Chip8Emulator::setPixelFormat(Chip8PixelFormat format) {
+  presenter.setFormat(format);
+}
+
+void Chip8Emulator::setBlend(uint8_t frames) { presenter.setBlend(frames); }
+
+void Chip8Emulator::setDecay(uint8_t persistence) {
+  presenter.setDecay(persistence);
+}
+
+bool Chip8Emulator::setStream(const string& address) {
+  streamer = make_unique<Chip8Streamer>();
+  if (!streamer->listen(address)) {
+    streamer.reset();
+    return false;
+  }
+  return true;
+}
+
+bool Chip8Emulator::setSharedState(const string& name) {
+  shared = make_unique<Chip8SharedState>();
+  if (!shared->open(name)) {
+    shared.reset();
+    return false;
+  }
+  return true;
+}
+
+const Chip8Metrics& Chip8Emulator::metrics() const { return stats; }
 
-      sleep_for(milliseconds(CHIP8_DELAY));
+void Chip8Emulator::runFrame() {
+  auto start = steady_clock::now();
+  if (!speculator || !speculator->adopt(chip8->keyboard, *chip8)) {
+    chip8->runFrame(cyclesPerFrame);
+  }
+  audioGenerator.generate(*chip8, audioRing, CHIP8_AUDIO_SAMPLES);
+  auto elapsed = steady_clock::now() - start;
+
+  // workers run the next frame while this one is presented
+  if (speculator) {
+    speculator->speculate(*chip8, cyclesPerFrame);
+    stats.speculationHits = speculator->hits();
+    stats.speculationMisses = speculator->misses();
+  }
+
+  stats.frames++;
+  if (shared) {
+    shared->publish(*chip8, stats.frames);
+  }
+  stats.emulationTime += duration_cast<nanoseconds>(elapsed).count();
+  stats.audioFill = audioRing.size();
+  stats.audioUnderruns = audioRing.underruns();
+}
+
+void Chip8Emulator::present() {
+  stats.presentedFrames++;
+  if (runAhead == 0) {
+    stats.uploadedBytes += hardwareManager->display(presenter.present(*chip8));
+    stream(*chip8);
+    chip8->clearDirty();
+    return;
+  }
+
+  // the real machine is never touched, so restoring the snapshot is free
+  auto start = steady_clock::now();
+  chip8->forkInto(*ahead);
+  // rows the previous run-ahead frames changed must be redrawn too
+  ahead->markDirty(aheadDirty);
+  for (uint32_t frame = 0; frame < runAhead; frame++) {
+    ahead->runFrame(cyclesPerFrame);
+  }
+  auto elapsed = steady_clock::now() - start;
+  stats.runAheadTime += duration_cast<nanoseconds>(elapsed).count();
+
+  stats.uploadedBytes += hardwareManager->display(presenter.present(*ahead));
+  stream(*ahead);
+  memset(aheadDirty, 0, sizeof(aheadDirty));
+  ahead->dirtyRows(aheadDirty);
+  chip8->clearDirty();
+}
+
+void Chip8Emulator::stream(const Chip8Machine& machine) {
+  if (streamer) {
+    streamer->publish(machine, stats.frames);
+    stats.streamedBytes = streamer->sentBytes();
+  }
+}
+
+bool Chip8Emulator::handleKeys() {
+  if (!keymap) {
+    return hardwareManager->handleKeys(chip8->keyboard);
+  }
+
+  auto run = hardwareManager->handleKeys(keys);
+  memset(chip8->keyboard, 0, sizeof(chip8->keyboard));
+  for (auto key = 0; key < CHIP8_KEYS; key++) {
+    chip8->keyboard[keymap[key]] |= keys[key];
+  }
+  return run;
+}
+
+void Chip8Emulator::runDeadline() {
+  const nanoseconds period{1000000000 / CHIP8_FRAME_RATE};
+  audioGenerator.setLatency(CHIP8_AUDIO_LATENCY);
+
+  auto deadline = steady_clock::now();
+  uint32_t skipped = 0;
+  auto run = true;
+  while (run) {
+    runFrame();
+    deadline += period;
+
+    // emulated time keeps its 60 Hz schedule, only presentation is dropped
+    if (steady_clock::now() > deadline && skipped < maxFrameSkip) {
+      skipped++;
+      stats.skippedFrames++;
+    } else {
+      present();
+      skipped = 0;
+    }
+    run = handleKeys() && !chip8->exited;
+
+    auto now = steady_clock::now();
+    if (now - deadline > (maxFrameSkip + 1) * period) {
+      // too far behind to catch up, restart the schedule from now
+      deadline = now;
     }
+    sleep_until(deadline);
   }
-}
\ No newline at end of file
+}
+
+void Chip8Emulator::runAudio() {
+  audioGenerator.setLatency(CHIP8_AUDIO_HIGH_WATER);
+
+  auto run = true;
+  while (run) {
+    // each frame adds CHIP8_AUDIO_SAMPLES, refilling only below the low
+    // water mark keeps the ring between the low and high water marks
+    uint32_t frames = 0;
+    while (frames <= maxFrameSkip &&
+           audioRing.size() < CHIP8_AUDIO_LOW_WATER) {
+      runFrame();
+      frames++;
+    }
+    if (frames > 1) {
+      stats.skippedFrames += frames - 1;
+    }
+    if (frames > 0) {
+      present();
+    } else {
+      // nothing new to show, wait for the ring to drain to the low water mark
+      auto queued = audioRing.size();
+      if (queued > CHIP8_AUDIO_LOW_WATER) {
+        sleep_for(microseconds((queued - CHIP8_AUDIO_LOW_WATER) * 1000000 /
+                               CHIP8_AUDIO_SAMPLE_RATE));
+      }
+    }
+    run = handleKeys() && !chip8->exited;
+  }
+}
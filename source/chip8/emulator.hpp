@@ -1,8 +1,20 @@
 #pragma once
 
+#include "audio.hpp"
 #include "chip8.hpp"
+#include "presenter.hpp"
+#include "romdb.hpp"
+#include "shared.hpp"
+#include "speculator.hpp"
+#include "stream.hpp"
 
-#define CHIP8_DELAY 10
+#define CHIP8_FRAME_RATE 60
+#define CHIP8_CYCLES_PER_FRAME 10
+#define CHIP8_AUDIO_SAMPLES (CHIP8_AUDIO_SAMPLE_RATE / CHIP8_FRAME_RATE)
+// about one frame queued: with the device period, under 30 ms to a beep
+#define CHIP8_AUDIO_LOW_WATER CHIP8_AUDIO_PERIOD
+#define CHIP8_AUDIO_HIGH_WATER (CHIP8_AUDIO_SAMPLES + CHIP8_AUDIO_PERIOD)
+#define CHIP8_MAX_FRAMESKIP 4
 
 using std::string;
 
@@ -15,8 +27,29 @@ class Chip8HardwareManager {
   Chip8HardwareManager() = default;
   virtual ~Chip8HardwareManager() = default;
 
-  virtual void display(const int32_t* video) = 0;
+  // returns the number of bytes uploaded to the display
+  virtual uint64_t display(const Chip8Frame& frame) = 0;
   virtual bool handleKeys(bool* keys) = 0;
+  virtual bool openAudio(AudioRing*) { return false; }
+};
+
+// Deadline sleeps until the next 60 Hz frame boundary, Audio lets the audio
+// device consumption rate decide how many frames to run.
+enum class Chip8Sync { Deadline, Audio };
+
+struct Chip8Metrics {
+  uint64_t frames = 0;
+  uint64_t presentedFrames = 0;
+  uint64_t skippedFrames = 0;
+  size_t audioFill = 0;
+  uint64_t audioUnderruns = 0;
+  double latencySaved = 0.0;
+  uint64_t emulationTime = 0;
+  uint64_t runAheadTime = 0;
+  uint64_t speculationHits = 0;
+  uint64_t speculationMisses = 0;
+  uint64_t uploadedBytes = 0;
+  uint64_t streamedBytes = 0;
 };
 
 class Chip8Emulator {
@@ -29,9 +62,50 @@ class Chip8Emulator {
   ~Chip8Emulator();
 
   void execute(const string& romfile);
+  void setProfile(Chip8Profile quirks);
+  void setSync(Chip8Sync mode);
+  void setMaxFrameSkip(uint32_t frames);
+  void setRunAhead(uint32_t frames);
+  void setSpeculation(uint32_t threads);
+  void setPalette(const Chip8Palette& palette);
+  void setPixelFormat(Chip8PixelFormat format);
+  void setBlend(uint8_t frames);
+  void setDecay(uint8_t persistence);
+  // publishes frame deltas, see Chip8Streamer
+  bool setStream(const string& address);
+  // exports the state after every frame, see chip8shm.h
+  bool setSharedState(const string& name);
+  const Chip8Metrics& metrics() const;
+
+ private:
+  void runFrame();
+  void present();
+  void stream(const Chip8Machine& machine);
+  bool handleKeys();
+  void runDeadline();
+  void runAudio();
 
  private:
   Chip8HardwareManager* hardwareManager = nullptr;
-  Chip8 chip8{};
+  unique_ptr<Chip8Machine> chip8;
+  unique_ptr<Chip8Machine> ahead;
+  Chip8Profile profile = Chip8Profile::Modern;
+  bool autoProfile = true;
+  uint32_t cyclesPerFrame = CHIP8_CYCLES_PER_FRAME;
+  const uint8_t* keymap = nullptr;
+  bool keys[CHIP8_KEYS] = {};
+  uint32_t maxFrameSkip = CHIP8_MAX_FRAMESKIP;
+  uint32_t runAhead = 0;
+  uint32_t speculation = 0;
+  unique_ptr<Chip8Speculator> speculator;
   bool validROM = false;
+  bool audioReady = false;
+  Chip8Sync sync = Chip8Sync::Audio;
+  Chip8Presenter presenter;
+  uint64_t aheadDirty[CHIP8_DIRTY_WORDS] = {};
+  unique_ptr<Chip8Streamer> streamer;
+  unique_ptr<Chip8SharedState> shared;
+  AudioRing audioRing{};
+  AudioGenerator audioGenerator{};
+  Chip8Metrics stats{};
 };
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include "environment.hpp"
+
+using std::lock_guard;
+using std::unique_lock;
+
+// Doubles every bit of a 32-bit word, 0b101 becomes 0b110011.
+static uint64_t doubleBits(uint64_t bits) {
+  bits = (bits | bits << 16) & 0x0000ffff0000ffffull;
+  bits = (bits | bits << 8) & 0x00ff00ff00ff00ffull;
+  bits = (bits | bits << 4) & 0x0f0f0f0f0f0f0f0full;
+  bits = (bits | bits << 2) & 0x3333333333333333ull;
+  bits = (bits | bits << 1) & 0x5555555555555555ull;
+  return bits | bits << 1;
+}
+
+Chip8Environment::Chip8Environment(const Chip8Machine& start,
+                                   const Chip8EnvironmentOptions& options)
+    : options(options) {
+  if (this->options.threads == 0) {
+    this->options.threads = std::max(1u, thread::hardware_concurrency());
+  }
+  this->options.threads =
+      std::clamp(this->options.threads, 1u, std::max(1u, options.environments));
+  if (start.profile() == Chip8Profile::MegaChip) {
+    this->options.environments = 0;
+    return;
+  }
+
+  auto hires = start.profile() == Chip8Profile::SuperChip ||
+               start.profile() == Chip8Profile::XoChip;
+  width = hires ? CHIP8_HIRES_WIDTH : CHIP8_VIDEO_WIDTH;
+  height = hires ? CHIP8_HIRES_HEIGHT : CHIP8_VIDEO_HEIGHT;
+  if (options.observation == Chip8ObservationMode::Downsampled) {
+    while (block * 2 <= std::min(options.block, 32u)) {
+      block *= 2;
+    }
+  }
+
+  root = start.clone();
+  image = root->snapshotMemory();
+  root->shareMemory(image);
+  pool = std::make_unique<Chip8Pool>(start.profile(), options.environments);
+  for (uint32_t i = 0; i < options.environments; i++) {
+    handles.push_back(pool->acquire(image));
+  }
+  steps.resize(options.environments);
+  episodes.resize(options.environments);
+  previous.resize(options.environments * options.rewards.size());
+  for (uint32_t i = 0; i < options.environments; i++) {
+    restart(i);
+  }
+
+  for (uint32_t worker = 1; worker < this->options.threads; worker++) {
+    workers.emplace_back(&Chip8Environment::work, this, worker);
+  }
+}
+
+Chip8Environment::~Chip8Environment() {
+  {
+    lock_guard<mutex> guard{lock};
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+uint32_t Chip8Environment::size() const { return options.environments; }
+
+uint32_t Chip8Environment::observationWidth() const { return width / block; }
+
+uint32_t Chip8Environment::observationHeight() const {
+  return height / block;
+}
+
+size_t Chip8Environment::observationSize() const {
+  auto pixels = observationWidth() * observationHeight();
+  return options.observation == Chip8ObservationMode::Packed ? pixels / 8
+                                                             : pixels;
+}
+
+void Chip8Environment::reset(uint64_t seed, uint8_t* observations) {
+  this->seed = seed;
+  std::fill(episodes.begin(), episodes.end(), 0);
+  this->observations = observations;
+  resetting = true;
+  dispatch();
+}
+
+void Chip8Environment::step(const int8_t* actions, uint8_t* observations,
+                            float* rewards, uint8_t* dones) {
+  this->actions = actions;
+  this->observations = observations;
+  this->rewards = rewards;
+  this->dones = dones;
+  resetting = false;
+  dispatch();
+}
+
+Chip8Machine& Chip8Environment::operator[](uint32_t environment) const {
+  return (*pool)[handles[environment]];
+}
+
+// The calling thread steps the first range while the workers step the
+// others.
+void Chip8Environment::dispatch() {
+  {
+    lock_guard<mutex> guard{lock};
+    pending = workers.size();
+    generation++;
+  }
+  wake.notify_all();
+  run(0);
+  unique_lock<mutex> guard{lock};
+  done.wait(guard, [this] { return pending == 0; });
+}
+
+void Chip8Environment::work(uint32_t worker) {
+  uint64_t seen = 0;
+  unique_lock<mutex> guard{lock};
+  while (true) {
+    wake.wait(guard, [&] { return stopping || generation != seen; });
+    if (stopping) {
+      return;
+    }
+    seen = generation;
+    guard.unlock();
+
+    run(worker);
+
+    guard.lock();
+    if (--pending == 0) {
+      done.notify_all();
+    }
+  }
+}
+
+void Chip8Environment::run(uint32_t worker) {
+  uint64_t environments = options.environments;
+  uint32_t first = environments * worker / options.threads;
+  uint32_t last = environments * (worker + 1) / options.threads;
+  auto probes = options.rewards.size();
+  for (auto i = first; i < last; i++) {
+    auto observation = observations + i * observationSize();
+    if (resetting) {
+      restart(i);
+      observe(i, observation);
+      continue;
+    }
+
+    auto& chip8 = (*this)[i];
+    for (auto key = 0; key < CHIP8_KEYS; key++) {
+      chip8.keyboard[key] = key == actions[i];
+    }
+    for (uint32_t frame = 0; frame < options.framesPerStep && !chip8.exited;
+         frame++) {
+      chip8.runFrame(options.cyclesPerFrame);
+    }
+    steps[i]++;
+
+    auto reward = 0.0f;
+    for (size_t probe = 0; probe < probes; probe++) {
+      auto& term = options.rewards[probe];
+      auto& before = previous[i * probes + probe];
+      auto value = chip8.read(term.address);
+      reward += term.scale * (term.delta ? value - before : value);
+      before = value;
+    }
+    auto finished =
+        chip8.exited || (options.maxSteps && steps[i] >= options.maxSteps);
+    for (auto& term : options.done) {
+      finished = finished || chip8.read(term.address) == term.value;
+    }
+    rewards[i] = reward;
+    dones[i] = finished;
+    if (finished) {
+      restart(i);
+    }
+    observe(i, observation);
+  }
+}
+
+void Chip8Environment::restart(uint32_t environment) {
+  auto& chip8 = (*this)[environment];
+  root->forkInto(chip8);
+  chip8.seedRandom(Chip8Machine::hashWord(
+      environment, seed ^ Chip8Machine::hashWord(1, ++episodes[environment])));
+  steps[environment] = 0;
+  auto probes = options.rewards.size();
+  for (size_t probe = 0; probe < probes; probe++) {
+    previous[environment * probes + probe] =
+        chip8.read(options.rewards[probe].address);
+  }
+}
+
+void Chip8Environment::observe(uint32_t environment,
+                               uint8_t* observation) const {
+  auto& screen = (*this)[environment].screen;
+  // rows at the observation resolution, leftmost pixel in the top bit
+  uint64_t rows[CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS];
+  auto words = width / 64;
+  if (words == 1 || screen.hires) {
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t word = 0; word < words; word++) {
+        rows[y][word] = screen.planes[0][y][word] | screen.planes[1][y][word];
+      }
+    }
+  } else {
+    for (uint32_t y = 0; y < height / 2; y++) {
+      auto bits = screen.planes[0][y][0] | screen.planes[1][y][0];
+      rows[2 * y][0] = rows[2 * y + 1][0] = doubleBits(bits >> 32);
+      rows[2 * y][1] = rows[2 * y + 1][1] = doubleBits(bits & 0xffffffff);
+    }
+  }
+
+  if (options.observation == Chip8ObservationMode::Packed) {
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t word = 0; word < words; word++) {
+        for (auto byte = 0; byte < 8; byte++) {
+          *observation++ = rows[y][word] >> (56 - 8 * byte);
+        }
+      }
+    }
+    return;
+  }
+
+  // blocks are counted only where a band of rows has lit pixels
+  auto mask = (uint64_t(1) << block) - 1;
+  auto area = block * block;
+  for (uint32_t y = 0; y < height; y += block) {
+    uint64_t any[CHIP8_ROW_WORDS] = {};
+    for (uint32_t row = y; row < y + block; row++) {
+      for (uint32_t word = 0; word < words; word++) {
+        any[word] |= rows[row][word];
+      }
+    }
+    for (uint32_t x = 0; x < width; x += block) {
+      auto shift = 64 - block - x % 64;
+      uint32_t lit = 0;
+      if ((any[x / 64] >> shift) & mask) {
+        for (uint32_t row = y; row < y + block; row++) {
+          lit += std::bitset<64>((rows[row][x / 64] >> shift) & mask).count();
+        }
+      }
+      *observation++ = lit * 255 / area;
+    }
+  }
+}
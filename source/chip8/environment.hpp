@@ -0,0 +1,114 @@
+#pragma once
+
+#include "pool.hpp"
+
+#define CHIP8_ENV_NOOP -1
+
+using std::condition_variable;
+using std::mutex;
+using std::thread;
+
+// Packed: one bit per pixel, lit when any plane is, leftmost pixel in the
+// most significant bit. Downsampled: one byte per square block of pixels,
+// 0 to 255 with the share of lit pixels.
+enum class Chip8ObservationMode { Packed, Downsampled };
+
+// Adds scale times the memory byte, or times its change over the step.
+struct Chip8RewardProbe {
+  uint16_t address;
+  float scale = 1.0f;
+  bool delta = false;
+};
+
+// Ends the episode when the memory byte equals value.
+struct Chip8DoneProbe {
+  uint16_t address;
+  uint8_t value;
+};
+
+struct Chip8EnvironmentOptions {
+  uint32_t environments = 1;
+  // 0 runs one worker per core
+  uint32_t threads = 0;
+  // each action holds one key, or none, for this many frames
+  uint32_t framesPerStep = 4;
+  // the emulator's default, CHIP8_CYCLES_PER_FRAME
+  uint32_t cyclesPerFrame = 10;
+  Chip8ObservationMode observation = Chip8ObservationMode::Packed;
+  // side of a downsampled block, a power of two up to 32
+  uint32_t block = 4;
+  vector<Chip8RewardProbe> rewards;
+  vector<Chip8DoneProbe> done;
+  // episodes also end after this many steps, 0 for never
+  uint32_t maxSteps = 0;
+};
+
+// A batch of environments started from the same machine, stepped together
+// in the gym style. Machines come from one pool and share the start memory
+// image. Observations, rewards and done flags are written straight into
+// caller-owned arrays, environment after environment, by worker threads
+// that each step a contiguous range. Observations have the largest
+// resolution of the profile: lo-res frames of SUPER-CHIP and XO-CHIP are
+// doubled. A finished environment restarts at once, its observation is the
+// first of the next episode. Not for MegaChip.
+class Chip8Environment {
+ private:
+  Chip8Environment(const Chip8Environment&) = delete;
+  Chip8Environment& operator=(const Chip8Environment&) = delete;
+
+ public:
+  Chip8Environment(const Chip8Machine& start,
+                   const Chip8EnvironmentOptions& options);
+  ~Chip8Environment();
+
+  uint32_t size() const;
+  // observation bytes per environment, width * height bytes when
+  // downsampled and width * height / 8 when packed
+  uint32_t observationWidth() const;
+  uint32_t observationHeight() const;
+  size_t observationSize() const;
+  // Every episode of every environment gets its own Cxkk random stream,
+  // derived from seed. observations holds size() * observationSize() bytes.
+  void reset(uint64_t seed, uint8_t* observations);
+  // one key or CHIP8_ENV_NOOP per environment, rewards and dones size()
+  void step(const int8_t* actions, uint8_t* observations, float* rewards,
+            uint8_t* dones);
+  Chip8Machine& operator[](uint32_t environment) const;
+
+ private:
+  void dispatch();
+  void work(uint32_t worker);
+  void run(uint32_t worker);
+  void restart(uint32_t environment);
+  void observe(uint32_t environment, uint8_t* observation) const;
+
+ private:
+  Chip8EnvironmentOptions options;
+  unique_ptr<Chip8Machine> root;
+  shared_ptr<const Chip8MemoryImage> image;
+  unique_ptr<Chip8Pool> pool;
+  vector<Chip8Handle> handles;
+  vector<uint32_t> steps;
+  vector<uint64_t> episodes;
+  // probed bytes at the last step, for delta rewards
+  vector<uint8_t> previous;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t block = 1;
+  uint64_t seed = 0;
+
+  // the call being run by the workers
+  const int8_t* actions = nullptr;
+  uint8_t* observations = nullptr;
+  float* rewards = nullptr;
+  uint8_t* dones = nullptr;
+  bool resetting = false;
+
+  vector<thread> workers;
+  mutex lock;
+  condition_variable wake;
+  condition_variable done;
+  uint64_t generation = 0;
+  uint32_t pending = 0;
+  bool stopping = false;
+};
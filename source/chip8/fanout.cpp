@@ -0,0 +1,164 @@
+#include "fanout.hpp"
+
+using std::lock_guard;
+using std::unique_lock;
+
+static void mergeDirty(uint64_t* into, const uint64_t* rows) {
+  for (auto i = 0; i < CHIP8_DIRTY_WORDS; i++) {
+    into[i] |= rows[i];
+  }
+}
+
+Chip8FanOut::Chip8FanOut() : pool(new Chip8SharedFrame[CHIP8_FANOUT_POOL]) {}
+
+Chip8FanOut::~Chip8FanOut() {
+  for (auto& sink : sinks) {
+    if (sink->mode == Chip8SinkMode::Inline) {
+      continue;
+    }
+    {
+      lock_guard<mutex> guard{sink->lock};
+      sink->stopping = true;
+    }
+    sink->ready.notify_one();
+    sink->worker.join();
+  }
+}
+
+void Chip8FanOut::add(Chip8HardwareManager* manager, Chip8SinkMode mode) {
+  sinks.push_back(std::make_unique<Sink>());
+  auto& sink = *sinks.back();
+  sink.manager.reset(manager);
+  sink.mode = mode;
+  if (mode != Chip8SinkMode::Inline) {
+    sink.worker = thread(&Chip8FanOut::work, this, std::ref(sink));
+  }
+}
+
+uint64_t Chip8FanOut::dropped(size_t sink) const {
+  return sink < sinks.size() ? sinks[sink]->drops.load() : 0;
+}
+
+void Chip8FanOut::release(Chip8SharedFrame* shared) {
+  shared->references.fetch_sub(1, std::memory_order_release);
+}
+
+// A free pool entry gets one copy of the pixels for every threaded sink.
+Chip8SharedFrame* Chip8FanOut::acquire(const Chip8Frame& frame,
+                                       uint32_t users) {
+  for (auto i = 0; i < CHIP8_FANOUT_POOL; i++) {
+    auto& shared = pool[i];
+    if (shared.references.load(std::memory_order_acquire) != 0) {
+      continue;
+    }
+    auto bpp = frame.format == Chip8PixelFormat::RGB565 ? 2 : 4;
+    memcpy(shared.pixels, frame.pixels,
+           size_t(frame.width) * frame.height * bpp);
+    shared.frame = frame;
+    shared.frame.pixels = shared.pixels;
+    shared.references.store(users, std::memory_order_relaxed);
+    return &shared;
+  }
+  return nullptr;
+}
+
+void Chip8FanOut::enqueue(Sink& sink, Chip8SharedFrame* shared,
+                          const Chip8Frame& presented) {
+  {
+    lock_guard<mutex> guard{sink.lock};
+    if (!shared) {
+      // the pool is exhausted, the next frame redraws these rows
+      mergeDirty(sink.carry, presented.dirty);
+      sink.drops++;
+      return;
+    }
+
+    auto frame = shared->frame;
+    mergeDirty(frame.dirty, sink.carry);
+    if (sink.queue.size() < CHIP8_FANOUT_QUEUE) {
+      memset(sink.carry, 0, sizeof(sink.carry));
+      sink.queue.emplace_back(shared, frame);
+    } else if (sink.mode == Chip8SinkMode::DropOldest) {
+      memset(sink.carry, 0, sizeof(sink.carry));
+      auto oldest = sink.queue.front();
+      sink.queue.pop_front();
+      mergeDirty(sink.queue.empty() ? frame.dirty
+                                    : sink.queue.front().second.dirty,
+                 oldest.second.dirty);
+      release(oldest.first);
+      sink.queue.emplace_back(shared, frame);
+      sink.drops++;
+    } else {
+      mergeDirty(sink.carry, frame.dirty);
+      release(shared);
+      sink.drops++;
+    }
+  }
+  sink.ready.notify_one();
+}
+
+uint64_t Chip8FanOut::display(const Chip8Frame& frame) {
+  uint32_t threaded = 0;
+  for (auto& sink : sinks) {
+    threaded += sink->mode != Chip8SinkMode::Inline;
+  }
+
+  uint64_t bytes = uploaded.exchange(0);
+  Chip8SharedFrame* shared = nullptr;
+  if (threaded > 0) {
+    shared = acquire(frame, threaded);
+  }
+  for (auto& sink : sinks) {
+    if (sink->mode == Chip8SinkMode::Inline) {
+      bytes += sink->manager->display(frame);
+    } else {
+      enqueue(*sink, shared, frame);
+    }
+  }
+  return bytes;
+}
+
+bool Chip8FanOut::handleKeys(bool* keys) {
+  auto run = true;
+  auto primary = true;
+  for (auto& sink : sinks) {
+    if (sink->mode != Chip8SinkMode::Inline) {
+      run &= sink->running.load();
+      continue;
+    }
+    run &= sink->manager->handleKeys(primary ? keys : scratch);
+    primary = false;
+  }
+  return run;
+}
+
+bool Chip8FanOut::openAudio(AudioRing* ring) {
+  for (auto& sink : sinks) {
+    if (sink->mode == Chip8SinkMode::Inline) {
+      return sink->manager->openAudio(ring);
+    }
+  }
+  return false;
+}
+
+// Threaded sinks also poll their own handleKeys, a sink that wants to stop
+// (a recorder at its frame limit) stops the emulation.
+void Chip8FanOut::work(Sink& sink) {
+  bool keys[CHIP8_KEYS] = {};
+  while (true) {
+    std::pair<Chip8SharedFrame*, Chip8Frame> next;
+    {
+      unique_lock<mutex> guard{sink.lock};
+      sink.ready.wait(guard,
+                      [&sink] { return sink.stopping || !sink.queue.empty(); });
+      if (sink.queue.empty()) {
+        return;
+      }
+      next = sink.queue.front();
+      sink.queue.pop_front();
+    }
+    uploaded += sink.manager->display(next.second);
+    release(next.first);
+    sink.running = sink.manager->handleKeys(keys);
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "emulator.hpp"
+
+#define CHIP8_FANOUT_POOL 8
+#define CHIP8_FANOUT_QUEUE 2
+
+using std::atomic;
+using std::condition_variable;
+using std::deque;
+using std::mutex;
+using std::thread;
+using std::unique_ptr;
+
+// How a sink gets its frames. Inline sinks run on the emulation thread.
+// Threaded sinks have a queue of CHIP8_FANOUT_QUEUE frames and, when it is
+// full, drop the incoming frame (DropNewest) or the oldest queued one
+// (DropOldest). Rows of dropped frames are redrawn with the next frame.
+enum class Chip8SinkMode { Inline, DropNewest, DropOldest };
+
+// Pixels of one presented frame shared by every threaded sink, released when
+// the last of them is done.
+struct Chip8SharedFrame {
+  atomic<uint32_t> references{0};
+  Chip8Frame frame;
+  uint8_t pixels[MEGACHIP_WIDTH * MEGACHIP_HEIGHT * sizeof(uint32_t)];
+};
+
+// Forwards every frame to several managers. The first inline sink is the
+// primary one: it reads the keyboard and opens the audio device. Frames are
+// copied once into a fixed pool for all threaded sinks; when the pool is
+// exhausted or a queue is full the frame is dropped for that sink and the
+// emulation never waits.
+class Chip8FanOut : public Chip8HardwareManager {
+ private:
+  Chip8FanOut(const Chip8FanOut&) = delete;
+  Chip8FanOut& operator=(const Chip8FanOut&) = delete;
+
+ public:
+  Chip8FanOut();
+  virtual ~Chip8FanOut();
+
+  // takes ownership of sink
+  void add(Chip8HardwareManager* sink, Chip8SinkMode mode);
+  uint64_t dropped(size_t sink) const;
+
+  virtual uint64_t display(const Chip8Frame& frame) override;
+  virtual bool handleKeys(bool* keys) override;
+  virtual bool openAudio(AudioRing* ring) override;
+
+ private:
+  struct Sink {
+    unique_ptr<Chip8HardwareManager> manager;
+    Chip8SinkMode mode;
+    thread worker;
+    mutex lock;
+    condition_variable ready;
+    deque<std::pair<Chip8SharedFrame*, Chip8Frame>> queue;
+    uint64_t carry[CHIP8_DIRTY_WORDS] = {};
+    atomic<uint64_t> drops{0};
+    atomic<bool> running{true};
+    bool stopping = false;
+  };
+
+  Chip8SharedFrame* acquire(const Chip8Frame& frame, uint32_t users);
+  void enqueue(Sink& sink, Chip8SharedFrame* shared,
+               const Chip8Frame& presented);
+  void work(Sink& sink);
+  static void release(Chip8SharedFrame* shared);
+
+ private:
+  vector<unique_ptr<Sink>> sinks;
+  unique_ptr<Chip8SharedFrame[]> pool;
+  atomic<uint64_t> uploaded{0};
+  bool scratch[CHIP8_KEYS] = {};
+};
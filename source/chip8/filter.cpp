@@ -0,0 +1,148 @@
+#include "filter.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// ceil(65536 / n), so the high half of sum * reciprocal is sum / n
+static const uint16_t reciprocals[CHIP8_FILTER_FRAMES + 1] = {0, 0, 32768,
+                                                              21846, 16384};
+
+void Chip8FrameFilter::setBlend(uint8_t count) {
+  mode = Chip8FilterMode::Blend;
+  frames = std::clamp<uint8_t>(count, 2, CHIP8_FILTER_FRAMES);
+  output.clear();
+}
+
+void Chip8FrameFilter::setDecay(uint8_t keep) {
+  mode = Chip8FilterMode::Decay;
+  persistence = keep;
+  output.clear();
+}
+
+void Chip8FrameFilter::disable() {
+  mode = Chip8FilterMode::None;
+  output.clear();
+}
+
+bool Chip8FrameFilter::enabled() const {
+  return mode != Chip8FilterMode::None;
+}
+
+// Starts over from frame: the history holds it frames times.
+void Chip8FrameFilter::resize(const uint32_t* frame, size_t pixels) {
+  output.assign(frame, frame + pixels);
+  for (auto& previous : history) {
+    previous.clear();
+  }
+  if (mode == Chip8FilterMode::Blend) {
+    for (auto i = 0; i < frames; i++) {
+      history[i] = output;
+    }
+  }
+  next = 0;
+}
+
+const uint32_t* Chip8FrameFilter::apply(const uint32_t* frame, uint16_t width,
+                                        uint16_t height, uint64_t* dirty) {
+  size_t pixels = size_t(width) * height;
+  if (mode == Chip8FilterMode::None) {
+    return frame;
+  }
+  if (output.size() != pixels) {
+    resize(frame, pixels);
+    return output.data();
+  }
+
+  if (mode == Chip8FilterMode::Blend) {
+    memcpy(history[next].data(), frame, pixels * sizeof(uint32_t));
+    next = (next + 1) % frames;
+  }
+  for (uint16_t row = 0; row < height; row++) {
+    size_t start = size_t(row) * width;
+    auto changed = mode == Chip8FilterMode::Blend
+                       ? blendRow(start, width)
+                       : decayRow(frame, start, width);
+    if (changed) {
+      dirty[row >> 6] |= 1ull << (row & 63);
+    }
+  }
+  return output.data();
+}
+
+// Averages each byte over the history, 4 pixels per step. Returns true when
+// the output row changed.
+bool Chip8FrameFilter::blendRow(size_t start, uint16_t width) {
+  auto out = reinterpret_cast<uint8_t*>(output.data() + start);
+  const uint8_t* in[CHIP8_FILTER_FRAMES];
+  for (auto i = 0; i < frames; i++) {
+    in[i] = reinterpret_cast<const uint8_t*>(history[i].data() + start);
+  }
+  auto reciprocal = reciprocals[frames];
+  auto bytes = size_t(width) * sizeof(uint32_t);
+  size_t i = 0;
+  bool changed = false;
+#ifdef __SSE2__
+  const auto zero = _mm_setzero_si128();
+  const auto scale = _mm_set1_epi16(reciprocal);
+  auto differs = _mm_setzero_si128();
+  for (; i + 16 <= bytes; i += 16) {
+    auto low = _mm_setzero_si128();
+    auto high = _mm_setzero_si128();
+    for (auto f = 0; f < frames; f++) {
+      auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[f] + i));
+      low = _mm_add_epi16(low, _mm_unpacklo_epi8(v, zero));
+      high = _mm_add_epi16(high, _mm_unpackhi_epi8(v, zero));
+    }
+    auto colour = _mm_packus_epi16(_mm_mulhi_epu16(low, scale),
+                                   _mm_mulhi_epu16(high, scale));
+    auto old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+    differs = _mm_or_si128(differs, _mm_xor_si128(old, colour));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), colour);
+  }
+  changed = _mm_movemask_epi8(_mm_cmpeq_epi8(differs, zero)) != 0xffff;
+#endif
+  for (; i < bytes; i++) {
+    uint32_t sum = 0;
+    for (auto f = 0; f < frames; f++) {
+      sum += in[f][i];
+    }
+    uint8_t colour = (sum * reciprocal) >> 16;
+    changed |= out[i] != colour;
+    out[i] = colour;
+  }
+  return changed;
+}
+
+// Each byte keeps the larger of the new frame and the decayed output.
+bool Chip8FrameFilter::decayRow(const uint32_t* frame, size_t start,
+                                uint16_t width) {
+  auto out = reinterpret_cast<uint8_t*>(output.data() + start);
+  auto in = reinterpret_cast<const uint8_t*>(frame + start);
+  auto bytes = size_t(width) * sizeof(uint32_t);
+  size_t i = 0;
+  bool changed = false;
+#ifdef __SSE2__
+  const auto zero = _mm_setzero_si128();
+  const auto keep = _mm_set1_epi16(persistence);
+  auto differs = _mm_setzero_si128();
+  for (; i + 16 <= bytes; i += 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    auto old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+    auto low = _mm_mullo_epi16(_mm_unpacklo_epi8(old, zero), keep);
+    auto high = _mm_mullo_epi16(_mm_unpackhi_epi8(old, zero), keep);
+    auto decayed =
+        _mm_packus_epi16(_mm_srli_epi16(low, 8), _mm_srli_epi16(high, 8));
+    auto colour = _mm_max_epu8(v, decayed);
+    differs = _mm_or_si128(differs, _mm_xor_si128(old, colour));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), colour);
+  }
+  changed = _mm_movemask_epi8(_mm_cmpeq_epi8(differs, zero)) != 0xffff;
+#endif
+  for (; i < bytes; i++) {
+    uint8_t colour = std::max<uint8_t>(in[i], (out[i] * persistence) >> 8);
+    changed |= out[i] != colour;
+    out[i] = colour;
+  }
+  return changed;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "chip8.hpp"
+
+#define CHIP8_FILTER_FRAMES 4
+
+enum class Chip8FilterMode { None, Blend, Decay };
+
+// Flicker reduction on presented RGBA frames. Blend averages the last 2 to
+// CHIP8_FILTER_FRAMES frames, Decay keeps persistence / 256 of the previous
+// output brightness per frame, like a slow phosphor. The emulation never sees
+// the filtered frames.
+class Chip8FrameFilter {
+ private:
+  Chip8FrameFilter(const Chip8FrameFilter&) = delete;
+  Chip8FrameFilter& operator=(const Chip8FrameFilter&) = delete;
+
+ public:
+  Chip8FrameFilter() = default;
+  ~Chip8FrameFilter() = default;
+
+  void setBlend(uint8_t frames);
+  void setDecay(uint8_t persistence);
+  void disable();
+  bool enabled() const;
+
+  // Filters a width x height frame and ORs the rows whose output changed into
+  // dirty. The result stays valid until the next call.
+  const uint32_t* apply(const uint32_t* frame, uint16_t width,
+                        uint16_t height, uint64_t* dirty);
+
+ private:
+  void resize(const uint32_t* frame, size_t pixels);
+  bool blendRow(size_t start, uint16_t width);
+  bool decayRow(const uint32_t* frame, size_t start, uint16_t width);
+
+ private:
+  Chip8FilterMode mode = Chip8FilterMode::None;
+  uint8_t frames = 2;
+  uint8_t persistence = 0;
+  uint8_t next = 0;
+  vector<uint32_t> history[CHIP8_FILTER_FRAMES];
+  vector<uint32_t> output;
+};
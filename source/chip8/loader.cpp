@@ -5,7 +5,25 @@ using std::endl;
 using std::ifstream;
 using std::ios;
 
-bool ROMLoader::loadROM(Chip8& chip8, const string& filename) {
+bool ROMLoader::loadROM(Chip8Machine& chip8, const string& filename) {
+  if (!readROM(filename)) {
+    return false;
+  }
+  return copyROM(chip8);
+}
+
+bool ROMLoader::readROM(const string& filename) {
+  auto member = filename.find(CHIP8_PACK_SUFFIX ":");
+  if (member != string::npos) {
+    Chip8ROMPack pack;
+    auto path = filename.substr(0, member + strlen(CHIP8_PACK_SUFFIX));
+    if (!pack.open(path)) {
+      cerr << "failed to open ROM pack: " << path << endl;
+      return false;
+    }
+    return readROM(pack, filename.substr(path.size() + 1));
+  }
+
   ifstream rom{filename, ios::binary};
   if (!rom.is_open()) {
     cerr << "failed to open ROM: " << filename << endl;
@@ -18,24 +36,45 @@ bool ROMLoader::loadROM(Chip8& chip8, const string& filename) {
     return false;
   }
 
-  if (romSize > CHIP8_MEMORY_SIZE - CHIP8_MEMORY_START) {
+  // the largest memory of any profile, copyROM() checks the machine's
+  if (romSize > MEGACHIP_MEMORY_SIZE - CHIP8_MEMORY_START) {
     cerr << "invalid ROM size: " << romSize << endl;
     return false;
   }
 
-  auto buffer = new char[romSize];
+  image.resize(romSize);
 
   rom.seekg(0, ios::beg);
-  rom.read(buffer, romSize);
+  rom.read(reinterpret_cast<char*>(image.data()), romSize);
   rom.close();
 
-  memcpy(chip8.memory + CHIP8_MEMORY_START, buffer, romSize);
+  rominfo = ROMDatabase::identify(image.data(), image.size());
+
+  return true;
+}
 
-  delete[] buffer;
+bool ROMLoader::readROM(const Chip8ROMPack& pack, const string& name) {
+  auto entry = pack.find(name);
+  if (!entry || !pack.read(*entry, image)) {
+    cerr << "failed to find ROM: " << name << endl;
+    return false;
+  }
+  rominfo = pack.info(*entry);
+  return true;
+}
 
+// Only XO-CHIP addresses more than 4 KB, so the limit depends on the machine.
+bool ROMLoader::copyROM(Chip8Machine& chip8) const {
+  if (image.size() > chip8.memorySize() - CHIP8_MEMORY_START) {
+    cerr << "invalid ROM size: " << image.size() << endl;
+    return false;
+  }
+  chip8.copyMemory(CHIP8_MEMORY_START, image.data(), image.size());
   return true;
 }
 
+const ROMInfo& ROMLoader::info() const { return rominfo; }
+
 uint8_t FontLoader::font[CHIP8_FONTS * CHIP8_FONT_SIZE] = {
     0xf0, 0x90, 0x90, 0x90, 0xf0,  // 0
     0x20, 0x60, 0x20, 0x20, 0x70,  // 1
@@ -55,8 +94,29 @@ uint8_t FontLoader::font[CHIP8_FONTS * CHIP8_FONT_SIZE] = {
     0xf0, 0x80, 0xf0, 0x80, 0x80   // F
 };
 
-void FontLoader::loadFont(Chip8& chip8) {
-  memcpy(chip8.memory + CHIP8_FONTS_START, font, sizeof(font));
+// SUPER-CHIP 8x10 digits, A-F from Octo
+uint8_t FontLoader::bigFont[CHIP8_FONTS * CHIP8_BIG_FONT_SIZE] = {
+    0x3c, 0x7e, 0xe7, 0xc3, 0xc3, 0xc3, 0xc3, 0xe7, 0x7e, 0x3c,  // 0
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3c,  // 1
+    0x3e, 0x7f, 0xc3, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xff, 0xff,  // 2
+    0x3c, 0x7e, 0xc3, 0x03, 0x0e, 0x0e, 0x03, 0xc3, 0x7e, 0x3c,  // 3
+    0x06, 0x0e, 0x1e, 0x36, 0x66, 0xc6, 0xff, 0xff, 0x06, 0x06,  // 4
+    0xff, 0xff, 0xc0, 0xc0, 0xfc, 0xfe, 0x03, 0xc3, 0x7e, 0x3c,  // 5
+    0x3e, 0x7c, 0xe0, 0xc0, 0xfc, 0xfe, 0xc3, 0xc3, 0x7e, 0x3c,  // 6
+    0xff, 0xff, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0x60, 0x60,  // 7
+    0x3c, 0x7e, 0xc3, 0xc3, 0x7e, 0x7e, 0xc3, 0xc3, 0x7e, 0x3c,  // 8
+    0x3c, 0x7e, 0xc3, 0xc3, 0x7f, 0x3f, 0x03, 0x03, 0x3e, 0x7c,  // 9
+    0x7e, 0xff, 0xc3, 0xc3, 0xc3, 0xff, 0xff, 0xc3, 0xc3, 0xc3,  // A
+    0xfc, 0xfc, 0xc3, 0xc3, 0xfc, 0xfc, 0xc3, 0xc3, 0xfc, 0xfc,  // B
+    0x3c, 0xff, 0xc3, 0xc0, 0xc0, 0xc0, 0xc0, 0xc3, 0xff, 0x3c,  // C
+    0xfc, 0xfe, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xfe, 0xfc,  // D
+    0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff,  // E
+    0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, 0xc0, 0xc0, 0xc0, 0xc0   // F
+};
+
+void FontLoader::loadFont(Chip8Machine& chip8) {
+  chip8.copyMemory(CHIP8_FONTS_START, font, sizeof(font));
+  chip8.copyMemory(CHIP8_BIG_FONTS_START, bigFont, sizeof(bigFont));
 }
 
 uint8_t FontLoader::getFont(uint8_t digit, uint8_t index) const {
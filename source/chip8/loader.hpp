@@ -1,6 +1,8 @@
 #pragma once
 
 #include "chip8.hpp"
+#include "romdb.hpp"
+#include "rompack.hpp"
 
 using std::string;
 
@@ -13,7 +15,16 @@ class ROMLoader {
   ROMLoader() = default;
   ~ROMLoader() = default;
 
-  bool loadROM(Chip8& chip8, const string& filename);
+  bool loadROM(Chip8Machine& chip8, const string& filename);
+  // filename may name a pack member as "pack.c8pk:name"
+  bool readROM(const string& filename);
+  bool readROM(const Chip8ROMPack& pack, const string& name);
+  bool copyROM(Chip8Machine& chip8) const;
+  const ROMInfo& info() const;
+
+ private:
+  vector<uint8_t> image;
+  ROMInfo rominfo{};
 };
 
 class FontLoader {
@@ -25,9 +36,10 @@ class FontLoader {
   FontLoader() = default;
   ~FontLoader() = default;
 
-  void loadFont(Chip8& chip8);
+  void loadFont(Chip8Machine& chip8);
   uint8_t getFont(uint8_t digit, uint8_t index) const;
 
  private:
   static uint8_t font[CHIP8_FONTS * CHIP8_FONT_SIZE];
+  static uint8_t bigFont[CHIP8_FONTS * CHIP8_BIG_FONT_SIZE];
 };
\ No newline at end of file
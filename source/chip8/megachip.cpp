@@ -0,0 +1,134 @@
+#include "megachip.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+void MegaChipScreen::reset() {
+  memset(pixels, 0, sizeof(pixels));
+  memset(palette, 0, sizeof(palette));
+  spriteWidth = 0;
+  spriteHeight = 0;
+  alpha = 0xff;
+  collision = 0;
+  blend = MegaChipBlend::Normal;
+  enabled = false;
+  memset(dirty, 0, sizeof(dirty));
+}
+
+void MegaChipScreen::clear() {
+  memset(pixels, 0, sizeof(pixels));
+  markAll();
+}
+
+void MegaChipScreen::markAll() { memset(dirty, 0xff, sizeof(dirty)); }
+
+void MegaChipScreen::scrollUp(uint8_t n) {
+  n = std::min<uint8_t>(n, MEGACHIP_HEIGHT);
+  memmove(pixels[0], pixels[n], (MEGACHIP_HEIGHT - n) * MEGACHIP_WIDTH);
+  memset(pixels[MEGACHIP_HEIGHT - n], 0, n * MEGACHIP_WIDTH);
+  markAll();
+}
+
+// 02nn colours are ARGB bytes, stored as RGBA for presentation, from index 1
+void MegaChipScreen::loadPalette(const uint8_t* argb, uint8_t count) {
+  for (auto i = 0; i < count && i + 1 < MEGACHIP_COLOURS; i++) {
+    auto colour = argb + 4 * i;
+    palette[i + 1] = colour[1] | (colour[2] << 8) | (colour[3] << 16) |
+                     (uint32_t(colour[0]) << 24);
+  }
+  markAll();
+}
+
+static uint8_t blendPixel(MegaChipBlend mode, uint8_t dst, uint8_t src) {
+  switch (mode) {
+    case MegaChipBlend::Blend25:
+      return (dst + ((dst + src + 1) >> 1) + 1) >> 1;
+    case MegaChipBlend::Blend50:
+      return (dst + src + 1) >> 1;
+    case MegaChipBlend::Add:
+      return std::min(dst + src, 0xff);
+    case MegaChipBlend::Multiply:
+      return (dst * src) >> 8;
+    case MegaChipBlend::Normal:
+    default:
+      return src;
+  }
+}
+
+// Returns true when an opaque sprite pixel lands on the collision colour.
+static bool blitRow(uint8_t* dst, const uint8_t* src, uint16_t count,
+                    MegaChipBlend mode, uint8_t collision) {
+  uint16_t i = 0;
+  bool hit = false;
+#ifdef __SSE2__
+  // 16 pixels per step, the rounding of _mm_avg_epu8 matches blendPixel
+  const auto zero = _mm_setzero_si128();
+  const auto target = _mm_set1_epi8(collision);
+  auto hits = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16) {
+    auto s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    auto transparent = _mm_cmpeq_epi8(s, zero);
+    hits = _mm_or_si128(
+        hits, _mm_andnot_si128(transparent, _mm_cmpeq_epi8(d, target)));
+
+    __m128i colour;
+    switch (mode) {
+      case MegaChipBlend::Blend25:
+        colour = _mm_avg_epu8(d, _mm_avg_epu8(d, s));
+        break;
+      case MegaChipBlend::Blend50:
+        colour = _mm_avg_epu8(d, s);
+        break;
+      case MegaChipBlend::Add:
+        colour = _mm_adds_epu8(d, s);
+        break;
+      case MegaChipBlend::Multiply: {
+        auto low = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+                                   _mm_unpacklo_epi8(s, zero));
+        auto high = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+                                    _mm_unpackhi_epi8(s, zero));
+        colour = _mm_packus_epi16(_mm_srli_epi16(low, 8),
+                                  _mm_srli_epi16(high, 8));
+        break;
+      }
+      case MegaChipBlend::Normal:
+      default:
+        colour = s;
+        break;
+    }
+    colour = _mm_or_si128(_mm_and_si128(transparent, d),
+                          _mm_andnot_si128(transparent, colour));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), colour);
+  }
+  hit = _mm_movemask_epi8(hits) != 0;
+#endif
+  for (; i < count; i++) {
+    if (src[i] == 0) {
+      continue;
+    }
+    hit |= dst[i] == collision;
+    dst[i] = blendPixel(mode, dst[i], src[i]);
+  }
+  return hit;
+}
+
+// Sprites are clipped at the screen edges. An 8-bit posx is always on the
+// 256-pixel wide screen, only posy can start below it.
+bool MegaChipScreen::blit(const uint8_t* sprite, uint16_t width,
+                          uint16_t height, uint8_t posx, uint8_t posy) {
+  if (posy >= MEGACHIP_HEIGHT) {
+    return false;
+  }
+  auto count = std::min<uint16_t>(width, MEGACHIP_WIDTH - posx);
+  auto rows = std::min<uint16_t>(height, MEGACHIP_HEIGHT - posy);
+  bool hit = false;
+  for (uint16_t row = 0; row < rows; row++) {
+    auto line = posy + row;
+    hit |= blitRow(pixels[line] + posx, sprite + row * width, count, blend,
+                   collision);
+    dirty[line >> 6] |= 1ull << (line & 63);
+  }
+  return hit;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "pch.h"
+
+#define MEGACHIP_WIDTH 256
+#define MEGACHIP_HEIGHT 192
+#define MEGACHIP_COLOURS 256
+#define MEGACHIP_MEMORY_SIZE 0x1000000
+#define MEGACHIP_DIRTY_WORDS (MEGACHIP_HEIGHT / 64)
+
+// 080n sprite blend modes
+enum class MegaChipBlend : uint8_t { Normal, Blend25, Blend50, Add, Multiply };
+
+// MegaChip framebuffer, one palette index per pixel. Index 0 is transparent
+// in sprites and black on screen. Blends work on the indices, which matches
+// the colour blend when the palette is a ramp as MegaChip ROMs use it.
+struct MegaChipScreen {
+  uint8_t pixels[MEGACHIP_HEIGHT][MEGACHIP_WIDTH];
+  uint32_t palette[MEGACHIP_COLOURS];
+  uint16_t spriteWidth;
+  uint16_t spriteHeight;
+  uint8_t alpha;
+  uint8_t collision;
+  MegaChipBlend blend;
+  bool enabled;
+  // bit n of word n / 64 is set when row n changed since the last present
+  uint64_t dirty[MEGACHIP_DIRTY_WORDS];
+
+  void reset();
+  void clear();
+  void markAll();
+  void scrollUp(uint8_t n);
+  void loadPalette(const uint8_t* argb, uint8_t count);
+  bool blit(const uint8_t* sprite, uint16_t width, uint16_t height,
+            uint8_t posx, uint8_t posy);
+};
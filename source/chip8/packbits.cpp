@@ -0,0 +1,50 @@
+#include "packbits.hpp"
+
+void packBits(const uint8_t* in, size_t size, vector<uint8_t>& out) {
+  size_t i = 0;
+  while (i < size) {
+    size_t run = 1;
+    while (i + run < size && run < 128 && in[i + run] == in[i]) {
+      run++;
+    }
+    if (run >= 2) {
+      out.push_back(257 - run);
+      out.push_back(in[i]);
+      i += run;
+      continue;
+    }
+    auto start = i;
+    while (i < size && i - start < 128 &&
+           !(i + 1 < size && in[i] == in[i + 1])) {
+      i++;
+    }
+    out.push_back(i - start - 1);
+    out.insert(out.end(), in + start, in + i);
+  }
+}
+
+bool unpackBits(const uint8_t* in, size_t size, uint8_t* out,
+                size_t capacity) {
+  size_t i = 0;
+  size_t n = 0;
+  while (i < size) {
+    auto header = in[i++];
+    if (header < 128) {
+      size_t count = header + 1;
+      if (i + count > size || n + count > capacity) {
+        return false;
+      }
+      memcpy(out + n, in + i, count);
+      i += count;
+      n += count;
+    } else if (header > 128) {
+      size_t count = 257 - header;
+      if (i >= size || n + count > capacity) {
+        return false;
+      }
+      memset(out + n, in[i++], count);
+      n += count;
+    }
+  }
+  return n == capacity;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+using std::vector;
+
+// PackBits: a header byte n < 128 copies the next n + 1 bytes, n > 128
+// repeats the next byte 257 - n times, 128 is skipped.
+void packBits(const uint8_t* in, size_t size, vector<uint8_t>& out);
+// false unless the data unpacks to exactly capacity bytes
+bool unpackBits(const uint8_t* in, size_t size, uint8_t* out,
+                size_t capacity);
@@ -7,9 +7,13 @@
 #include <string.h>
 
 #include <algorithm>
+#include <atomic>
 #include <bitset>
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iomanip>
@@ -17,6 +21,8 @@
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <queue>
 #include <random>
 #include <set>
 #include <sstream>
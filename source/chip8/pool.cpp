@@ -0,0 +1,79 @@
+#include "pool.hpp"
+
+#define CHIP8_POOL_ALIGN 64
+
+Chip8Pool::Chip8Pool(Chip8Profile profile, uint32_t capacity)
+    : profile(profile),
+      stride((Chip8Machine::instanceSize(profile) + CHIP8_POOL_ALIGN - 1) &
+             ~size_t(CHIP8_POOL_ALIGN - 1)),
+      slots(capacity),
+      arena(static_cast<uint8_t*>(::operator new(
+          stride * capacity, std::align_val_t(CHIP8_POOL_ALIGN)))),
+      machines(capacity, nullptr) {
+  // lowest slots first, so a partly used pool stays compact
+  free.reserve(capacity);
+  for (auto slot = capacity; slot > 0; slot--) {
+    free.push_back(slot - 1);
+  }
+}
+
+Chip8Pool::~Chip8Pool() {
+  for (auto machine : machines) {
+    if (machine) {
+      machine->~Chip8Machine();
+    }
+  }
+  ::operator delete(arena, std::align_val_t(CHIP8_POOL_ALIGN));
+}
+
+Chip8Handle Chip8Pool::acquire(
+    const shared_ptr<const Chip8MemoryImage>& image) {
+  if (free.empty()) {
+    return CHIP8_NO_HANDLE;
+  }
+  auto handle = free.back();
+  free.pop_back();
+  // a shared image is given at construction, so no private memory is made
+  auto machine =
+      Chip8Machine::createAt(arena + handle * stride, profile, image);
+  machines[handle] = machine;
+  return handle;
+}
+
+void Chip8Pool::release(Chip8Handle handle) {
+  if (handle >= slots || !machines[handle]) {
+    return;
+  }
+  machines[handle]->~Chip8Machine();
+  machines[handle] = nullptr;
+  free.push_back(handle);
+}
+
+Chip8Machine& Chip8Pool::operator[](Chip8Handle handle) const {
+  return *machines[handle];
+}
+
+uint32_t Chip8Pool::size() const { return slots - free.size(); }
+
+uint32_t Chip8Pool::capacity() const { return slots; }
+
+// A live slot counts its padding and what its machine holds, a free one the
+// arena bytes it reserves.
+size_t Chip8Pool::footprint() const {
+  size_t bytes = machines.capacity() * sizeof(Chip8Machine*) +
+                 free.capacity() * sizeof(Chip8Handle);
+  auto padding = stride - Chip8Machine::instanceSize(profile);
+  for (auto machine : machines) {
+    bytes += machine ? padding + machine->footprint() : stride;
+  }
+  return bytes;
+}
+
+size_t Chip8Pool::instanceFootprint() const {
+  size_t bytes = 0;
+  auto padding = stride - Chip8Machine::instanceSize(profile);
+  for (auto machine : machines) {
+    bytes += machine ? padding + machine->footprint() : 0;
+  }
+  return size() ? bytes / size() : 0;
+}
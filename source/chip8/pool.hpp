@@ -0,0 +1,41 @@
+#pragma once
+
+#include "chip8.hpp"
+
+#define CHIP8_NO_HANDLE 0xffffffffu
+
+using std::shared_ptr;
+
+typedef uint32_t Chip8Handle;
+
+// Fixed arena of machines of one profile, laid out back to back on cache
+// line boundaries. A handle is a slot number and stays valid until released;
+// machines never move. Machines acquired with an image share it and
+// allocate no memory of their own.
+class Chip8Pool {
+ private:
+  Chip8Pool(const Chip8Pool&) = delete;
+  Chip8Pool& operator=(const Chip8Pool&) = delete;
+
+ public:
+  Chip8Pool(Chip8Profile profile, uint32_t capacity);
+  ~Chip8Pool();
+
+  // CHIP8_NO_HANDLE when the pool is full
+  Chip8Handle acquire(const shared_ptr<const Chip8MemoryImage>& image);
+  void release(Chip8Handle handle);
+  Chip8Machine& operator[](Chip8Handle handle) const;
+  uint32_t size() const;
+  uint32_t capacity() const;
+  // bytes used by the arena and the live machines, and by one on average
+  size_t footprint() const;
+  size_t instanceFootprint() const;
+
+ private:
+  Chip8Profile profile;
+  size_t stride;
+  uint32_t slots;
+  uint8_t* arena;
+  vector<Chip8Machine*> machines;
+  vector<Chip8Handle> free;
+};
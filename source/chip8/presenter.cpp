@@ -0,0 +1,216 @@
+#include "presenter.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Colours are RGBA bytes in memory, 0xAABBGGRR on little-endian hosts.
+static const struct {
+  const char* name;
+  Chip8Palette palette;
+} palettes[] = {
+    {"mono", {{0x00000000, 0xffffffff, 0xffaaaaaa, 0xff555555}}},
+    {"octo", {{0xff006699, 0xff00ccff, 0xff0066ff, 0xff002266}}},
+    {"amber", {{0xff000000, 0xff00b0ff, 0xff005a80, 0xff0080c0}}},
+    {"green", {{0xff001000, 0xff33ff33, 0xff118011, 0xff22c022}}},
+};
+
+static uint16_t toRGB565(uint32_t colour) {
+  auto r = colour & 0xff;
+  auto g = (colour >> 8) & 0xff;
+  auto b = (colour >> 16) & 0xff;
+  return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+const Chip8Palette* Chip8Palette::find(const string& name) {
+  for (auto& entry : palettes) {
+    if (name == entry.name) {
+      return &entry.palette;
+    }
+  }
+  return nullptr;
+}
+
+static bool isDirty(const uint64_t* dirty, uint16_t row) {
+  return (dirty[row >> 6] >> (row & 63)) & 1;
+}
+
+Chip8Presenter::Chip8Presenter() { setPalette(palettes[0].palette); }
+
+void Chip8Presenter::setPalette(const Chip8Palette& colours) {
+  palette = colours;
+  for (auto i = 0; i < CHIP8_PALETTE_COLOURS; i++) {
+    palette565[i] = toRGB565(palette.colours[i]);
+  }
+  refresh = true;
+}
+
+void Chip8Presenter::setFormat(Chip8PixelFormat pixelFormat) {
+  format = pixelFormat;
+  refresh = true;
+}
+
+void Chip8Presenter::setBlend(uint8_t frames) {
+  filter.setBlend(frames);
+  refresh = true;
+}
+
+void Chip8Presenter::setDecay(uint8_t persistence) {
+  filter.setDecay(persistence);
+  refresh = true;
+}
+
+// Only rows changed since the previous frame are converted, everything is
+// redrawn after a palette, format, filter or resolution change. The filter
+// works on RGBA, its output is converted to RGB565 afterwards when needed.
+Chip8Frame Chip8Presenter::present(const Chip8Machine& machine) {
+  Chip8Frame frame{rgba, 0, 0, format, {}};
+  if (format == Chip8PixelFormat::RGB565) {
+    frame.pixels = rgb565;
+  }
+
+  auto indexed = machine.mega && machine.mega->enabled;
+  frame.width = indexed ? MEGACHIP_WIDTH : machine.screen.width();
+  frame.height = indexed ? MEGACHIP_HEIGHT : machine.screen.height();
+  if (refresh || frame.width != lastWidth || frame.height != lastHeight) {
+    memset(frame.dirty, 0xff, sizeof(frame.dirty));
+    refresh = false;
+    lastWidth = frame.width;
+    lastHeight = frame.height;
+  } else {
+    machine.dirtyRows(frame.dirty);
+  }
+
+  auto target = filter.enabled() ? Chip8PixelFormat::RGBA8888 : format;
+  if (indexed) {
+    presentIndexed(*machine.mega, frame.dirty, target);
+  } else {
+    presentPlanes(machine.screen, frame.dirty, target);
+  }
+  if (!filter.enabled()) {
+    return frame;
+  }
+
+  auto filtered = filter.apply(rgba, frame.width, frame.height, frame.dirty);
+  if (format == Chip8PixelFormat::RGB565) {
+    for (auto row = 0; row < frame.height; row++) {
+      if (!isDirty(frame.dirty, row)) {
+        continue;
+      }
+      auto start = row * frame.width;
+      for (auto i = start; i < start + frame.width; i++) {
+        rgb565[i] = toRGB565(filtered[i]);
+      }
+    }
+  } else {
+    frame.pixels = filtered;
+  }
+  return frame;
+}
+
+// Each output lane tests one pixel bit of both planes and selects its palette
+// entry with masks: 4 RGBA or 8 RGB565 pixels per step.
+void Chip8Presenter::presentPlanes(const Chip8Screen& screen,
+                                   const uint64_t* dirty,
+                                   Chip8PixelFormat target) {
+  auto width = screen.width();
+  auto height = screen.height();
+  auto out32 = rgba;
+  auto out16 = rgb565;
+
+#ifdef __SSE2__
+  const auto lanes32 = _mm_set_epi32(1, 2, 4, 8);
+  const auto lanes16 = _mm_set_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+  __m128i colours[CHIP8_PALETTE_COLOURS];
+  for (auto i = 0; i < CHIP8_PALETTE_COLOURS; i++) {
+    if (target == Chip8PixelFormat::RGB565) {
+      colours[i] = _mm_set1_epi16(palette565[i]);
+    } else {
+      colours[i] = _mm_set1_epi32(palette.colours[i]);
+    }
+  }
+  auto select = [&colours](__m128i mask0, __m128i mask1) {
+    auto low = _mm_or_si128(_mm_and_si128(mask0, colours[1]),
+                            _mm_andnot_si128(mask0, colours[0]));
+    auto high = _mm_or_si128(_mm_and_si128(mask0, colours[3]),
+                             _mm_andnot_si128(mask0, colours[2]));
+    return _mm_or_si128(_mm_and_si128(mask1, high),
+                        _mm_andnot_si128(mask1, low));
+  };
+#endif
+
+  for (auto row = 0; row < height; row++) {
+    if (!isDirty(dirty, row)) {
+      out32 += width;
+      out16 += width;
+      continue;
+    }
+    for (auto word = 0; word < width / 64; word++) {
+      auto plane0 = screen.planes[0][row][word];
+      auto plane1 = screen.planes[1][row][word];
+#ifdef __SSE2__
+      if (target == Chip8PixelFormat::RGB565) {
+        for (auto shift = 56; shift >= 0; shift -= 8) {
+          auto bits0 = _mm_set1_epi16((plane0 >> shift) & 0xff);
+          auto bits1 = _mm_set1_epi16((plane1 >> shift) & 0xff);
+          auto mask0 = _mm_cmpeq_epi16(_mm_and_si128(bits0, lanes16), lanes16);
+          auto mask1 = _mm_cmpeq_epi16(_mm_and_si128(bits1, lanes16), lanes16);
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(out16),
+                           select(mask0, mask1));
+          out16 += 8;
+        }
+      } else {
+        for (auto shift = 60; shift >= 0; shift -= 4) {
+          auto bits0 = _mm_set1_epi32((plane0 >> shift) & 0xf);
+          auto bits1 = _mm_set1_epi32((plane1 >> shift) & 0xf);
+          auto mask0 = _mm_cmpeq_epi32(_mm_and_si128(bits0, lanes32), lanes32);
+          auto mask1 = _mm_cmpeq_epi32(_mm_and_si128(bits1, lanes32), lanes32);
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(out32),
+                           select(mask0, mask1));
+          out32 += 4;
+        }
+      }
+#else
+      for (auto bit = 63; bit >= 0; bit--) {
+        auto index = ((plane0 >> bit) & 1) | (((plane1 >> bit) & 1) << 1);
+        if (target == Chip8PixelFormat::RGB565) {
+          *out16++ = palette565[index];
+        } else {
+          *out32++ = palette.colours[index];
+        }
+      }
+#endif
+    }
+  }
+}
+
+// MegaChip colours come from the ROM palette, scaled by the screen alpha
+// (05nn). SSE2 has no gather, so this is a table lookup per pixel.
+void Chip8Presenter::presentIndexed(const MegaChipScreen& screen,
+                                    const uint64_t* dirty,
+                                    Chip8PixelFormat target) {
+  uint32_t colours[MEGACHIP_COLOURS];
+  uint16_t colours565[MEGACHIP_COLOURS];
+  for (auto i = 0; i < MEGACHIP_COLOURS; i++) {
+    auto a = ((screen.palette[i] >> 24) * screen.alpha) / 0xff;
+    colours[i] = (screen.palette[i] & 0x00ffffff) | (a << 24);
+    colours565[i] = toRGB565(colours[i]);
+  }
+
+  for (auto row = 0; row < MEGACHIP_HEIGHT; row++) {
+    if (!isDirty(dirty, row)) {
+      continue;
+    }
+    auto pixel = screen.pixels[row];
+    auto start = row * MEGACHIP_WIDTH;
+    if (target == Chip8PixelFormat::RGB565) {
+      for (auto i = 0; i < MEGACHIP_WIDTH; i++) {
+        rgb565[start + i] = colours565[pixel[i]];
+      }
+    } else {
+      for (auto i = 0; i < MEGACHIP_WIDTH; i++) {
+        rgba[start + i] = colours[pixel[i]];
+      }
+    }
+  }
+}
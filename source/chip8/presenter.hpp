@@ -0,0 +1,65 @@
+#pragma once
+
+#include "chip8.hpp"
+#include "filter.hpp"
+
+#define CHIP8_PALETTE_COLOURS (1 << XOCHIP_PLANES)
+
+using std::string;
+
+enum class Chip8PixelFormat { RGBA8888, RGB565 };
+
+// Pixels of the presented frame, width x height changes with the resolution
+// mode. pixels is uint32_t RGBA8888 or uint16_t RGB565 as format says. Rows
+// whose dirty bit (bit n of word n / 64) is clear are unchanged since the
+// previous frame.
+struct Chip8Frame {
+  const void* pixels;
+  uint16_t width;
+  uint16_t height;
+  Chip8PixelFormat format;
+  uint64_t dirty[CHIP8_DIRTY_WORDS];
+};
+
+// RGBA colour of each plane combination: background, plane 0, plane 1, both
+struct Chip8Palette {
+  uint32_t colours[CHIP8_PALETTE_COLOURS];
+
+  static const Chip8Palette* find(const string& name);
+};
+
+// Presentation stage: the core only stores plane bits or MegaChip palette
+// indices, colours are looked up here once per presented frame.
+class Chip8Presenter {
+ private:
+  Chip8Presenter(const Chip8Presenter&) = delete;
+  Chip8Presenter& operator=(const Chip8Presenter&) = delete;
+
+ public:
+  Chip8Presenter();
+  ~Chip8Presenter() = default;
+
+  void setPalette(const Chip8Palette& colours);
+  void setFormat(Chip8PixelFormat pixelFormat);
+  // Flicker filter, see Chip8FrameFilter
+  void setBlend(uint8_t frames);
+  void setDecay(uint8_t persistence);
+  Chip8Frame present(const Chip8Machine& machine);
+
+ private:
+  void presentPlanes(const Chip8Screen& screen, const uint64_t* dirty,
+                     Chip8PixelFormat target);
+  void presentIndexed(const MegaChipScreen& screen, const uint64_t* dirty,
+                      Chip8PixelFormat target);
+
+ private:
+  Chip8Palette palette;
+  uint16_t palette565[CHIP8_PALETTE_COLOURS];
+  Chip8PixelFormat format = Chip8PixelFormat::RGBA8888;
+  uint16_t lastWidth = 0;
+  uint16_t lastHeight = 0;
+  bool refresh = true;
+  Chip8FrameFilter filter;
+  uint32_t rgba[MEGACHIP_WIDTH * MEGACHIP_HEIGHT];
+  uint16_t rgb565[MEGACHIP_WIDTH * MEGACHIP_HEIGHT];
+};
@@ -0,0 +1,360 @@
+#include "recorder.hpp"
+
+using std::lock_guard;
+using std::unique_lock;
+
+static void put16(ofstream& file, uint16_t value) {
+  file.put(value & 0xff);
+  file.put(value >> 8);
+}
+
+static uint64_t hashPixels(const vector<uint32_t>& pixels) {
+  // FNV-1a over whole pixels
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (auto pixel : pixels) {
+    hash = (hash ^ pixel) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+Chip8Recorder::Chip8Recorder(const string& path, Chip8RecordFormat format,
+                             uint64_t frames, uint16_t width, uint16_t height)
+    : file(path, std::ios::binary),
+      format(format),
+      width(width),
+      height(height),
+      limit(frames),
+      staging(size_t(width) * height),
+      queue(CHIP8_RECORDER_QUEUE) {
+  for (auto& entry : queue) {
+    entry.pixels.resize(staging.size());
+  }
+  current.pixels.resize(staging.size());
+
+  if (format == Chip8RecordFormat::Y4M) {
+    file << "YUV4MPEG2 W" << width << " H" << height
+         << " F60:1 Ip A1:1 C444\n";
+  } else if (format == Chip8RecordFormat::GIF) {
+    // no global colour table, loops forever
+    file << "GIF89a";
+    put16(file, width);
+    put16(file, height);
+    file.put(0).put(0).put(0);
+    file << "\x21\xff\x0bNETSCAPE2.0\x03\x01";
+    file.put(0).put(0).put(0);
+  }
+  encoder = thread(&Chip8Recorder::encode, this);
+}
+
+Chip8Recorder::~Chip8Recorder() {
+  {
+    lock_guard<mutex> guard{lock};
+    stopping = true;
+  }
+  ready.notify_one();
+  encoder.join();
+  if (format == Chip8RecordFormat::GIF) {
+    flushGIF();
+    file.put(0x3b);
+  }
+}
+
+bool Chip8Recorder::isOpen() const { return file.is_open(); }
+
+uint64_t Chip8Recorder::duplicates() const {
+  lock_guard<mutex> guard{lock};
+  return repeated;
+}
+
+uint64_t Chip8Recorder::dropped() const {
+  lock_guard<mutex> guard{lock};
+  return skipped;
+}
+
+Chip8RecordFormat Chip8Recorder::formatOf(const string& path) {
+  auto dot = path.rfind('.');
+  auto extension = dot == string::npos ? "" : path.substr(dot + 1);
+  if (extension == "y4m") {
+    return Chip8RecordFormat::Y4M;
+  }
+  if (extension == "gif") {
+    return Chip8RecordFormat::GIF;
+  }
+  return Chip8RecordFormat::Raw;
+}
+
+// Nearest sampling to the recording size, RGB565 is expanded to RGBA.
+void Chip8Recorder::scale(const Chip8Frame& frame) {
+  auto out = staging.data();
+  for (auto y = 0; y < height; y++) {
+    auto row = size_t(y * frame.height / height) * frame.width;
+    for (auto x = 0; x < width; x++) {
+      auto i = row + x * frame.width / width;
+      if (frame.format == Chip8PixelFormat::RGB565) {
+        auto pixel = static_cast<const uint16_t*>(frame.pixels)[i];
+        *out++ = 0xff000000 | ((pixel >> 11) << 3) |
+                 (((pixel >> 5) & 0x3f) << 10) | ((pixel & 0x1f) << 19);
+      } else {
+        *out++ = static_cast<const uint32_t*>(frame.pixels)[i];
+      }
+    }
+  }
+}
+
+uint64_t Chip8Recorder::display(const Chip8Frame& frame) {
+  presented++;
+  auto unchanged = synced && frame.width == lastWidth &&
+                   frame.height == lastHeight;
+  for (auto word : frame.dirty) {
+    unchanged &= word == 0;
+  }
+  lastWidth = frame.width;
+  lastHeight = frame.height;
+
+  uint64_t hash = lastHash;
+  if (!unchanged) {
+    scale(frame);
+    hash = hashPixels(staging);
+  }
+
+  {
+    lock_guard<mutex> guard{lock};
+    auto duplicate = synced && hash == lastHash;
+    if (duplicate || count == queue.size()) {
+      if (count > 0) {
+        queue[(head + count - 1) % queue.size()].repeats++;
+      } else {
+        lateRepeats++;
+      }
+      repeated += duplicate;
+      skipped += !duplicate;
+      // the file shows the previous frame, the next one must be compared
+      synced = duplicate;
+    } else {
+      auto& entry = queue[(head + count) % queue.size()];
+      entry.pixels.swap(staging);
+      entry.repeats = 0;
+      count++;
+      lastHash = hash;
+      synced = true;
+    }
+  }
+  ready.notify_one();
+  return 0;
+}
+
+bool Chip8Recorder::handleKeys(bool*) {
+  return limit == 0 || presented < limit;
+}
+
+void Chip8Recorder::encode() {
+  while (true) {
+    uint32_t repeats = 0;
+    auto next = false;
+    {
+      unique_lock<mutex> guard{lock};
+      ready.wait(guard, [this] {
+        return stopping || count > 0 || lateRepeats > 0;
+      });
+      if (stopping && count == 0 && lateRepeats == 0) {
+        return;
+      }
+      // repeats of the previous frame are taken before the next frame
+      repeats = lateRepeats;
+      lateRepeats = 0;
+      if (count > 0) {
+        current.pixels.swap(queue[head].pixels);
+        current.repeats = queue[head].repeats;
+        head = (head + 1) % queue.size();
+        count--;
+        next = true;
+      }
+    }
+    repeatFrame(repeats);
+    if (next) {
+      writeFrame(current);
+    }
+  }
+}
+
+void Chip8Recorder::writeFrame(const Entry& entry) {
+  written = true;
+  if (format == Chip8RecordFormat::Raw) {
+    buffer.assign(reinterpret_cast<const uint8_t*>(entry.pixels.data()),
+                  reinterpret_cast<const uint8_t*>(entry.pixels.data() +
+                                                   entry.pixels.size()));
+  } else if (format == Chip8RecordFormat::Y4M) {
+    // BT.601 studio range, one plane after the other
+    auto pixels = entry.pixels.size();
+    buffer.resize(3 * pixels);
+    for (size_t i = 0; i < pixels; i++) {
+      int r = entry.pixels[i] & 0xff;
+      int g = (entry.pixels[i] >> 8) & 0xff;
+      int b = (entry.pixels[i] >> 16) & 0xff;
+      buffer[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+      buffer[pixels + i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+      buffer[2 * pixels + i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    }
+  } else {
+    flushGIF();
+    encodeGIF(entry.pixels);
+  }
+  repeatFrame(entry.repeats + 1);
+}
+
+// Raw and Y4M have a constant frame rate and write the frame again, a GIF
+// frame is shown longer.
+void Chip8Recorder::repeatFrame(uint32_t count) {
+  if (!written) {
+    return;
+  }
+  if (format == Chip8RecordFormat::GIF) {
+    gifPending += count;
+    return;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    if (format == Chip8RecordFormat::Y4M) {
+      file << "FRAME\n";
+    }
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+  }
+}
+
+// Writes the pending GIF frame once its duration is known. Delays are in
+// 1/100 s and rounded against the 60 Hz timeline so they do not drift.
+void Chip8Recorder::flushGIF() {
+  if (gifPending == 0) {
+    return;
+  }
+  auto start = gifTicks * 100 / CHIP8_FRAME_RATE;
+  gifTicks += gifPending;
+  gifPending = 0;
+  auto delay = gifTicks * 100 / CHIP8_FRAME_RATE - start;
+  file << "\x21\xf9\x04\x04";
+  put16(file, std::min<uint64_t>(delay, 0xffff));
+  file.put(0).put(0);
+  file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+}
+
+// Image descriptor, local colour table and LZW data of one frame. Frames
+// with more than 256 colours fall back to a 3-3-2 colour cube.
+void Chip8Recorder::encodeGIF(const vector<uint32_t>& pixels) {
+  unordered_map<uint32_t, uint8_t> colours;
+  vector<uint32_t> table;
+  auto cube = false;
+  for (auto pixel : pixels) {
+    auto rgb = pixel & 0x00ffffff;
+    if (colours.count(rgb) == 0) {
+      if (table.size() == 256) {
+        cube = true;
+        break;
+      }
+      colours[rgb] = table.size();
+      table.push_back(rgb);
+    }
+  }
+  if (cube) {
+    table.clear();
+    for (uint32_t i = 0; i < 256; i++) {
+      auto r = (i >> 5) * 255 / 7;
+      auto g = ((i >> 2) & 7) * 255 / 7;
+      auto b = (i & 3) * 255 / 3;
+      table.push_back(r | (g << 8) | (b << 16));
+    }
+  }
+  uint8_t bits = 1;
+  while ((1u << bits) < table.size()) {
+    bits++;
+  }
+  table.resize(1 << bits, 0);
+
+  buffer.clear();
+  auto put = [this](uint8_t byte) { buffer.push_back(byte); };
+  auto put16 = [&put](uint16_t value) {
+    put(value & 0xff);
+    put(value >> 8);
+  };
+  put(0x2c);
+  put16(0);
+  put16(0);
+  put16(width);
+  put16(height);
+  put(0x80 | (bits - 1));
+  for (auto colour : table) {
+    put(colour & 0xff);
+    put((colour >> 8) & 0xff);
+    put(colour >> 16);
+  }
+
+  uint8_t minimum = std::max<uint8_t>(bits, 2);
+  put(minimum);
+  auto blockStart = buffer.size();
+  put(0);
+  uint32_t accumulator = 0;
+  uint8_t pending = 0;
+  auto emitByte = [&](uint8_t byte) {
+    if (buffer[blockStart] == 255) {
+      blockStart = buffer.size();
+      put(0);
+    }
+    put(byte);
+    buffer[blockStart]++;
+  };
+  uint8_t codeSize = minimum + 1;
+  auto emit = [&](uint16_t code) {
+    accumulator |= uint32_t(code) << pending;
+    pending += codeSize;
+    while (pending >= 8) {
+      emitByte(accumulator & 0xff);
+      accumulator >>= 8;
+      pending -= 8;
+    }
+  };
+  auto index = [&](uint32_t pixel) -> uint8_t {
+    auto rgb = pixel & 0x00ffffff;
+    if (cube) {
+      return (((rgb & 0xff) >> 5) << 5) | ((((rgb >> 8) & 0xff) >> 5) << 2) |
+             (rgb >> 22);
+    }
+    return colours[rgb];
+  };
+
+  // same code size rules as the decoder: grow when the next code needs it
+  uint16_t clear = 1 << minimum;
+  uint16_t next = clear + 2;
+  dictionary.clear();
+  emit(clear);
+  uint16_t prefix = index(pixels[0]);
+  for (size_t i = 1; i < pixels.size(); i++) {
+    auto value = index(pixels[i]);
+    uint32_t key = (uint32_t(prefix) << 8) | value;
+    auto found = dictionary.find(key);
+    if (found != dictionary.end()) {
+      prefix = found->second;
+      continue;
+    }
+    emit(prefix);
+    dictionary[key] = next;
+    if (next >= (1u << codeSize) && codeSize < 12) {
+      codeSize++;
+    }
+    next++;
+    if (next == 4096) {
+      emit(clear);
+      dictionary.clear();
+      codeSize = minimum + 1;
+      next = clear + 2;
+    }
+    prefix = value;
+  }
+  emit(prefix);
+  // the decoder adds an entry for the last code before it reads the end
+  if (next == (1u << codeSize) && codeSize < 12) {
+    codeSize++;
+  }
+  emit(clear + 1);
+  if (pending > 0) {
+    emitByte(accumulator & 0xff);
+  }
+  put(0);
+}
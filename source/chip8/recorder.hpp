@@ -0,0 +1,92 @@
+#pragma once
+
+#include "emulator.hpp"
+
+#define CHIP8_RECORDER_QUEUE 32
+#define CHIP8_RECORDER_WIDTH 128
+#define CHIP8_RECORDER_HEIGHT 64
+
+using std::condition_variable;
+using std::mutex;
+using std::ofstream;
+using std::string;
+using std::thread;
+using std::unordered_map;
+
+enum class Chip8RecordFormat { Raw, Y4M, GIF };
+
+// Headless manager writing every presented frame to a video file: raw RGBA,
+// Y4M (4:4:4, 60 fps) or an animated GIF. Frames are scaled to a fixed size.
+// Identical consecutive frames are detected by hash and only extend the
+// previous frame. Encoding runs on a background thread fed by a bounded
+// queue; when it falls behind a frame is recorded as a repeat instead of
+// blocking the emulation.
+class Chip8Recorder : public Chip8HardwareManager {
+ private:
+  Chip8Recorder(const Chip8Recorder&) = delete;
+  Chip8Recorder& operator=(const Chip8Recorder&) = delete;
+
+ public:
+  // frames > 0 stops the emulation after that many presented frames
+  Chip8Recorder(const string& path, Chip8RecordFormat format,
+                uint64_t frames = 0, uint16_t width = CHIP8_RECORDER_WIDTH,
+                uint16_t height = CHIP8_RECORDER_HEIGHT);
+  virtual ~Chip8Recorder();
+
+  virtual uint64_t display(const Chip8Frame& frame) override;
+  virtual bool handleKeys(bool* keys) override;
+
+  bool isOpen() const;
+  uint64_t duplicates() const;
+  uint64_t dropped() const;
+  // raw, y4m or gif from the file extension, raw when unknown
+  static Chip8RecordFormat formatOf(const string& path);
+
+ private:
+  struct Entry {
+    vector<uint32_t> pixels;
+    uint32_t repeats = 0;
+  };
+
+  void scale(const Chip8Frame& frame);
+  void encode();
+  void writeFrame(const Entry& entry);
+  void repeatFrame(uint32_t count);
+  void encodeGIF(const vector<uint32_t>& pixels);
+  void flushGIF();
+
+ private:
+  ofstream file;
+  Chip8RecordFormat format;
+  uint16_t width;
+  uint16_t height;
+  uint64_t limit;
+  uint64_t presented = 0;
+
+  // producer side
+  vector<uint32_t> staging;
+  uint64_t lastHash = 0;
+  bool synced = false;
+  uint16_t lastWidth = 0;
+  uint16_t lastHeight = 0;
+
+  // bounded queue, repeats of the frame being encoded go to lateRepeats
+  vector<Entry> queue;
+  size_t head = 0;
+  size_t count = 0;
+  uint32_t lateRepeats = 0;
+  uint64_t repeated = 0;
+  uint64_t skipped = 0;
+  bool stopping = false;
+  mutable mutex lock;
+  condition_variable ready;
+  thread encoder;
+
+  // encoder side
+  Entry current;
+  bool written = false;
+  vector<uint8_t> buffer;
+  uint64_t gifTicks = 0;
+  uint32_t gifPending = 0;
+  unordered_map<uint32_t, uint16_t> dictionary;
+};
@@ -0,0 +1,145 @@
+#include "romdb.hpp"
+
+#include "emulator.hpp"
+
+// FNV-1a, 64 bits
+#define ROMDB_HASH_OFFSET 0xcbf29ce484222325ull
+#define ROMDB_HASH_PRIME 0x100000001b3ull
+#define ROMDB_SCHIP_CYCLES 30
+#define ROMDB_XOCHIP_CYCLES 200
+#define ROMDB_MEGACHIP_CYCLES 1000
+
+// Sorted by hash for binary search, checked at compile time below.
+static constexpr ROMInfo database[] = {
+    {0x518c0287840c0507, Chip8Profile::Modern, 20, nullptr, "4-flags"},
+    {0x7ce94f81f0ddb2f2, Chip8Profile::Modern, 10, nullptr, "2-ibm-logo"},
+    {0xced34281d9dae5c0, Chip8Profile::Modern, 20, nullptr, "3-corax+"},
+    {0xf29eda105324f103, Chip8Profile::Modern, 10, nullptr, "1-chip8-logo"},
+};
+
+static constexpr bool sorted() {
+  for (size_t i = 1; i < sizeof(database) / sizeof(database[0]); i++) {
+    if (database[i - 1].hash >= database[i].hash) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(sorted(), "ROM database must be sorted by hash");
+
+uint64_t ROMDatabase::hash(const uint8_t* data, size_t size) {
+  uint64_t value = ROMDB_HASH_OFFSET;
+  for (size_t i = 0; i < size; i++) {
+    value ^= data[i];
+    value *= ROMDB_HASH_PRIME;
+  }
+  return value;
+}
+
+const ROMInfo* ROMDatabase::lookup(uint64_t hash) {
+  auto first = std::begin(database);
+  auto last = std::end(database);
+  auto entry = std::lower_bound(
+      first, last, hash,
+      [](const ROMInfo& info, uint64_t value) { return info.hash < value; });
+  if (entry == last || entry->hash != hash) {
+    return nullptr;
+  }
+  return entry;
+}
+
+ROMInfo ROMDatabase::identify(const uint8_t* data, size_t size) {
+  auto value = hash(data, size);
+  auto entry = lookup(value);
+  if (entry) {
+    return *entry;
+  }
+  return guess(value, data, size);
+}
+
+ROMInfo ROMDatabase::guess(uint64_t hash, const uint8_t* data, size_t size) {
+  ROMInfo info{hash, Chip8Profile::Modern, CHIP8_CYCLES_PER_FRAME, nullptr,
+               nullptr};
+
+  // sprite data often looks like SUPER-CHIP instructions, so only code
+  // reachable from the entry point is scanned. XO-CHIP extends SUPER-CHIP,
+  // the scan goes on after a SUPER-CHIP instruction looking for one.
+  vector<bool> visited(size, false);
+  vector<size_t> pending{0};
+  while (!pending.empty()) {
+    auto offset = pending.back();
+    pending.pop_back();
+
+    while (offset < size && offset + 1 < size && !visited[offset]) {
+      visited[offset] = true;
+      auto instruction = (data[offset] << 8) | data[offset + 1];
+      auto address = instruction & 0x0fff;
+      auto low = instruction & 0xff;
+      auto next = offset + 2;
+
+      switch (instruction & 0xf000) {
+        case 0x0000:
+          if (instruction == 0x00ee || instruction == 0x00fd) {
+            next = size;
+          } else if (instruction == 0x0011) {
+            info.profile = Chip8Profile::MegaChip;
+          } else if ((instruction & 0xfff0) == 0x00c0 ||
+                     instruction == 0x00fb || instruction == 0x00fc ||
+                     instruction == 0x00fe || instruction == 0x00ff) {
+            info.profile = Chip8Profile::SuperChip;
+          } else if ((instruction & 0xfff0) == 0x00d0) {
+            info.profile = Chip8Profile::XoChip;
+          }
+          break;
+        case 0x1000:
+          next = address - CHIP8_MEMORY_START;
+          break;
+        case 0x2000:
+          pending.push_back(address - CHIP8_MEMORY_START);
+          break;
+        case 0x5000:
+          if ((instruction & 0x000f) == 0x2 || (instruction & 0x000f) == 0x3) {
+            info.profile = Chip8Profile::XoChip;
+            break;
+          }
+          pending.push_back(offset + 4);
+          break;
+        case 0x3000:
+        case 0x4000:
+        case 0x9000:
+        case 0xe000:
+          pending.push_back(offset + 4);
+          break;
+        case 0xb000:
+          next = size;
+          break;
+        case 0xd000:
+          if ((instruction & 0x000f) == 0) {
+            info.profile = Chip8Profile::SuperChip;
+          }
+          break;
+        case 0xf000:
+          if (instruction == 0xf000 || instruction == 0xf002 || low == 0x01 ||
+              low == 0x3a) {
+            info.profile = Chip8Profile::XoChip;
+          } else if (low == 0x30 || low == 0x75 || low == 0x85) {
+            info.profile = Chip8Profile::SuperChip;
+          }
+          break;
+      }
+      if (info.profile == Chip8Profile::XoChip) {
+        info.cyclesPerFrame = ROMDB_XOCHIP_CYCLES;
+        return info;
+      }
+      if (info.profile == Chip8Profile::MegaChip) {
+        info.cyclesPerFrame = ROMDB_MEGACHIP_CYCLES;
+        return info;
+      }
+      offset = next;
+    }
+  }
+  if (info.profile == Chip8Profile::SuperChip) {
+    info.cyclesPerFrame = ROMDB_SCHIP_CYCLES;
+  }
+  return info;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "chip8.hpp"
+
+// Known ROM settings. keymap maps the host keypad slot to the CHIP-8 key it
+// presses, nullptr keeps the default layout.
+struct ROMInfo {
+  uint64_t hash;
+  Chip8Profile profile;
+  uint16_t cyclesPerFrame;
+  const uint8_t* keymap;
+  const char* name;
+};
+
+class ROMDatabase {
+ private:
+  ROMDatabase() = delete;
+
+ public:
+  static uint64_t hash(const uint8_t* data, size_t size);
+  static const ROMInfo* lookup(uint64_t hash);
+  static ROMInfo identify(const uint8_t* data, size_t size);
+
+ private:
+  static ROMInfo guess(uint64_t hash, const uint8_t* data, size_t size);
+};
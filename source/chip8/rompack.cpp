@@ -0,0 +1,247 @@
+#include "rompack.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "packbits.hpp"
+
+using std::ofstream;
+
+static_assert(sizeof(Chip8PackHeader) == 16, "packed header layout");
+static_assert(sizeof(Chip8PackEntry) == 32, "packed entry layout");
+
+Chip8ROMPack::~Chip8ROMPack() {
+  if (bytes) {
+    munmap(const_cast<uint8_t*>(bytes), length);
+  }
+}
+
+// Everything is checked here once, so lookups and loads trust the index.
+bool Chip8ROMPack::open(const string& path) {
+  auto fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  auto mapped = MAP_FAILED;
+  if (fstat(fd, &status) == 0 &&
+      size_t(status.st_size) >= sizeof(Chip8PackHeader)) {
+    mapped = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+
+  auto data = static_cast<const uint8_t*>(mapped);
+  auto size = size_t(status.st_size);
+  auto head = reinterpret_cast<const Chip8PackHeader*>(data);
+  auto index =
+      sizeof(Chip8PackHeader) +
+      size_t(head->count) * (sizeof(Chip8PackEntry) + sizeof(uint32_t));
+  auto valid = head->magic == CHIP8_PACK_MAGIC &&
+               head->version == CHIP8_PACK_VERSION && head->size == size &&
+               index <= size;
+  auto list = reinterpret_cast<const Chip8PackEntry*>(head + 1);
+  auto order = reinterpret_cast<const uint32_t*>(list + head->count);
+  for (uint32_t i = 0; valid && i < head->count; i++) {
+    auto& entry = list[i];
+    valid = order[i] < head->count && entry.name >= index &&
+            entry.name < size &&
+            memchr(data + entry.name, 0, size - entry.name) &&
+            entry.offset >= index && entry.offset <= size &&
+            entry.stored <= size - entry.offset && entry.size > 0 &&
+            entry.size <= MEGACHIP_MEMORY_SIZE - CHIP8_MEMORY_START &&
+            ((entry.flags & CHIP8_PACK_PACKED) || entry.stored == entry.size) &&
+            (i == 0 || list[i - 1].hash <= entry.hash);
+  }
+  // find() searches both indexes, names are known terminated by now
+  auto text = [&](uint32_t n) {
+    return reinterpret_cast<const char*>(data + list[order[n]].name);
+  };
+  for (uint32_t i = 1; valid && i < head->count; i++) {
+    valid = strcmp(text(i - 1), text(i)) < 0;
+  }
+  if (!valid) {
+    munmap(mapped, size);
+    return false;
+  }
+
+  if (bytes) {
+    munmap(const_cast<uint8_t*>(bytes), length);
+  }
+  bytes = data;
+  length = size;
+  header = head;
+  entries = list;
+  names = order;
+  return true;
+}
+
+uint32_t Chip8ROMPack::count() const { return header ? header->count : 0; }
+
+const Chip8PackEntry* Chip8ROMPack::entry(uint32_t n) const {
+  return n < count() ? &entries[n] : nullptr;
+}
+
+const Chip8PackEntry* Chip8ROMPack::find(uint64_t hash) const {
+  auto last = entries + count();
+  auto entry = std::lower_bound(
+      entries, last, hash,
+      [](const Chip8PackEntry& e, uint64_t value) { return e.hash < value; });
+  if (entry == last || entry->hash != hash) {
+    return nullptr;
+  }
+  return entry;
+}
+
+const Chip8PackEntry* Chip8ROMPack::find(const string& name) const {
+  auto last = names + count();
+  auto n = std::lower_bound(names, last, name, [this](uint32_t e, auto& key) {
+    return strcmp(this->name(entries[e]), key.c_str()) < 0;
+  });
+  if (n == last || name != this->name(entries[*n])) {
+    return nullptr;
+  }
+  return &entries[*n];
+}
+
+const char* Chip8ROMPack::name(const Chip8PackEntry& entry) const {
+  return reinterpret_cast<const char*>(bytes + entry.name);
+}
+
+// The database knows keymaps the pack does not store.
+ROMInfo Chip8ROMPack::info(const Chip8PackEntry& entry) const {
+  auto known = ROMDatabase::lookup(entry.hash);
+  if (known) {
+    return *known;
+  }
+  return ROMInfo{entry.hash, Chip8Profile(entry.profile), entry.cyclesPerFrame,
+                 nullptr, nullptr};
+}
+
+bool Chip8ROMPack::load(Chip8Machine& chip8,
+                        const Chip8PackEntry& entry) const {
+  if (entry.size > chip8.memorySize() - CHIP8_MEMORY_START) {
+    return false;
+  }
+  // a machine sharing its memory copies the pages it is given
+  if (!chip8.memory) {
+    vector<uint8_t> image;
+    if (!read(entry, image)) {
+      return false;
+    }
+    chip8.copyMemory(CHIP8_MEMORY_START, image.data(), image.size());
+    return true;
+  }
+  auto memory = chip8.memory + CHIP8_MEMORY_START;
+  if (entry.flags & CHIP8_PACK_PACKED) {
+    return unpackBits(bytes + entry.offset, entry.stored, memory, entry.size);
+  }
+  memcpy(memory, bytes + entry.offset, entry.size);
+  return true;
+}
+
+bool Chip8ROMPack::read(const Chip8PackEntry& entry,
+                        vector<uint8_t>& image) const {
+  image.resize(entry.size);
+  if (entry.flags & CHIP8_PACK_PACKED) {
+    return unpackBits(bytes + entry.offset, entry.stored, image.data(),
+                      entry.size);
+  }
+  memcpy(image.data(), bytes + entry.offset, entry.size);
+  return true;
+}
+
+bool Chip8ROMPackBuilder::add(const string& name,
+                              const vector<uint8_t>& image) {
+  if (image.empty() ||
+      image.size() > MEGACHIP_MEMORY_SIZE - CHIP8_MEMORY_START) {
+    return false;
+  }
+  for (auto& other : images) {
+    if (other.name == name) {
+      return false;
+    }
+  }
+  images.push_back({name, image});
+  return true;
+}
+
+bool Chip8ROMPackBuilder::write(const string& path, bool compress) const {
+  auto count = uint32_t(images.size());
+  vector<Chip8PackEntry> entries(count);
+  vector<vector<uint8_t>> stored(count);
+  vector<uint32_t> byHash(count);
+  vector<uint32_t> byName(count);
+  for (uint32_t i = 0; i < count; i++) {
+    auto& image = images[i].data;
+    auto info = ROMDatabase::identify(image.data(), image.size());
+    auto& entry = entries[i];
+    entry = {};
+    entry.hash = info.hash;
+    entry.size = image.size();
+    entry.cyclesPerFrame = info.cyclesPerFrame;
+    entry.profile = uint8_t(info.profile);
+    if (compress) {
+      packBits(image.data(), image.size(), stored[i]);
+    }
+    if (!compress || stored[i].size() >= image.size()) {
+      stored[i] = image;
+    } else {
+      entry.flags = CHIP8_PACK_PACKED;
+    }
+    entry.stored = stored[i].size();
+    byHash[i] = i;
+    byName[i] = i;
+  }
+  std::sort(byHash.begin(), byHash.end(), [&entries](uint32_t a, uint32_t b) {
+    return entries[a].hash < entries[b].hash;
+  });
+  std::sort(byName.begin(), byName.end(), [this](uint32_t a, uint32_t b) {
+    return images[a].name < images[b].name;
+  });
+
+  // entry i of the file is image byHash[i]
+  vector<uint32_t> position(count);
+  for (uint32_t i = 0; i < count; i++) {
+    position[byHash[i]] = i;
+  }
+  size_t offset = sizeof(Chip8PackHeader) +
+                  size_t(count) * (sizeof(Chip8PackEntry) + sizeof(uint32_t));
+  for (uint32_t i = 0; i < count; i++) {
+    entries[i].name = offset;
+    offset += images[i].name.size() + 1;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    entries[i].offset = offset;
+    offset += entries[i].stored;
+  }
+  if (offset > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+
+  ofstream pack{path, std::ios::binary};
+  if (!pack.is_open()) {
+    return false;
+  }
+  Chip8PackHeader header{CHIP8_PACK_MAGIC, CHIP8_PACK_VERSION, count,
+                         uint32_t(offset)};
+  pack.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (auto n : byHash) {
+    pack.write(reinterpret_cast<const char*>(&entries[n]),
+               sizeof(Chip8PackEntry));
+  }
+  for (auto n : byName) {
+    pack.write(reinterpret_cast<const char*>(&position[n]), sizeof(uint32_t));
+  }
+  for (auto& image : images) {
+    pack.write(image.name.c_str(), image.name.size() + 1);
+  }
+  for (auto& image : stored) {
+    pack.write(reinterpret_cast<const char*>(image.data()), image.size());
+  }
+  return bool(pack);
+}
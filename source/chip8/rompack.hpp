@@ -0,0 +1,90 @@
+#pragma once
+
+#include "chip8.hpp"
+#include "romdb.hpp"
+
+#define CHIP8_PACK_MAGIC 0x4b503843  // "C8PK"
+#define CHIP8_PACK_VERSION 1
+#define CHIP8_PACK_PACKED 1
+#define CHIP8_PACK_SUFFIX ".c8pk"
+
+using std::string;
+
+// Single-file ROM corpus, little endian, read in place once mapped:
+//   Chip8PackHeader
+//   Chip8PackEntry[count]  sorted by hash
+//   uint32[count]          entry numbers sorted by name
+//   names                  NUL terminated
+//   images                 raw, or PackBits when flags has CHIP8_PACK_PACKED
+// Offsets are from the start of the file.
+struct Chip8PackHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t size;
+};
+
+struct Chip8PackEntry {
+  uint64_t hash;
+  uint32_t offset;
+  uint32_t name;
+  uint32_t size;
+  uint32_t stored;
+  uint16_t cyclesPerFrame;
+  uint8_t profile;
+  uint8_t flags;
+  uint32_t reserved;
+};
+
+// Maps a pack once; loading a ROM is then a memcpy (or an unpack) straight
+// into the machine memory, without any system call.
+class Chip8ROMPack {
+ private:
+  Chip8ROMPack(const Chip8ROMPack&) = delete;
+  Chip8ROMPack& operator=(const Chip8ROMPack&) = delete;
+
+ public:
+  Chip8ROMPack() = default;
+  ~Chip8ROMPack();
+
+  bool open(const string& path);
+  uint32_t count() const;
+  const Chip8PackEntry* entry(uint32_t n) const;
+  const Chip8PackEntry* find(uint64_t hash) const;
+  const Chip8PackEntry* find(const string& name) const;
+  const char* name(const Chip8PackEntry& entry) const;
+  ROMInfo info(const Chip8PackEntry& entry) const;
+  bool load(Chip8Machine& chip8, const Chip8PackEntry& entry) const;
+  // unpacked image, for callers that keep their own copy
+  bool read(const Chip8PackEntry& entry, vector<uint8_t>& image) const;
+
+ private:
+  const uint8_t* bytes = nullptr;
+  size_t length = 0;
+  const Chip8PackHeader* header = nullptr;
+  const Chip8PackEntry* entries = nullptr;
+  const uint32_t* names = nullptr;
+};
+
+// Collects ROM images and writes them as a pack.
+class Chip8ROMPackBuilder {
+ private:
+  Chip8ROMPackBuilder(const Chip8ROMPackBuilder&) = delete;
+  Chip8ROMPackBuilder& operator=(const Chip8ROMPackBuilder&) = delete;
+
+ public:
+  Chip8ROMPackBuilder() = default;
+  ~Chip8ROMPackBuilder() = default;
+
+  // false for an empty or oversized image or a duplicate name
+  bool add(const string& name, const vector<uint8_t>& image);
+  // with compress, images are stored packed when that makes them smaller
+  bool write(const string& path, bool compress) const;
+
+ private:
+  struct Image {
+    string name;
+    vector<uint8_t> data;
+  };
+  vector<Image> images;
+};
@@ -0,0 +1,262 @@
+#include "search.hpp"
+
+using std::priority_queue;
+
+#define CHIP8_SEARCH_EMPTY 0
+// stands in for a zero hash, which marks empty slots
+#define CHIP8_SEARCH_ZERO 1
+
+Chip8VisitedTable::Chip8VisitedTable(size_t capacity) {
+  // at most half full keeps the probe sequences short
+  size_t size = 16;
+  while (size < 2 * capacity) {
+    size <<= 1;
+  }
+  slots.reset(new atomic<uint64_t>[size]);
+  for (size_t slot = 0; slot < size; slot++) {
+    slots[slot].store(CHIP8_SEARCH_EMPTY, std::memory_order_relaxed);
+  }
+  mask = size - 1;
+}
+
+bool Chip8VisitedTable::insert(uint64_t hash) {
+  if (hash == CHIP8_SEARCH_EMPTY) {
+    hash = CHIP8_SEARCH_ZERO;
+  }
+  // state hashes are already mixed, the low bits pick the slot
+  for (size_t probe = 0; probe <= mask; probe++) {
+    auto& slot = slots[(hash + probe) & mask];
+    auto current = slot.load(std::memory_order_relaxed);
+    if (current == hash) {
+      return false;
+    }
+    if (current == CHIP8_SEARCH_EMPTY) {
+      if (slot.compare_exchange_strong(current, hash,
+                                       std::memory_order_relaxed)) {
+        count.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+      // lost the race: the winner may have inserted the same hash
+      if (current == hash) {
+        return false;
+      }
+    }
+  }
+  return false;
+}
+
+size_t Chip8VisitedTable::size() const {
+  return count.load(std::memory_order_relaxed);
+}
+
+uint32_t Chip8SearchGoal::met(const Chip8Machine& chip8) const {
+  uint32_t conditions = 0;
+  for (auto& [address, value] : memory) {
+    conditions += chip8.read(address) == value;
+  }
+  for (auto& [x, y] : pixels) {
+    conditions += x < chip8.screen.width() && y < chip8.screen.height() &&
+                  chip8.screen.pixel(x, y);
+  }
+  return conditions;
+}
+
+bool Chip8SearchGoal::reached(const Chip8Machine& chip8) const {
+  auto conditions = memory.size() + pixels.size();
+  return conditions && met(chip8) == conditions;
+}
+
+Chip8Search::Chip8Search(const Chip8Machine& start,
+                         const Chip8SearchOptions& options)
+    : options(options),
+      start{},
+      visited(options.maxStates + 1) {
+  if (this->options.threads == 0) {
+    this->options.threads = std::max(1u, thread::hardware_concurrency());
+  }
+  if (start.profile() == Chip8Profile::MegaChip) {
+    return;
+  }
+
+  root = start.clone();
+  image = root->snapshotMemory();
+  root->shareMemory(image);
+  root->enableStateHash();
+  // forks copy the generator, so children replay whatever thread runs them
+  root->seedRandom(options.seed);
+  this->start.machine = root.get();
+  this->start.handle = CHIP8_NO_HANDLE;
+  this->start.score = score(*root);
+  this->start.input = CHIP8_SEARCH_NONE;
+
+  // twice an even share of the states, as workers claim nodes unevenly
+  auto machines = std::min<uint64_t>(2ull * options.maxStates,
+                                     CHIP8_SEARCH_MACHINES);
+  uint32_t capacity = machines / this->options.threads + CHIP8_SEARCH_INPUTS;
+  for (uint32_t i = 0; i < this->options.threads; i++) {
+    auto worker = std::make_unique<Worker>();
+    worker->pool = std::make_unique<Chip8Pool>(start.profile(), capacity);
+    worker->scratch = worker->pool->acquire(image);
+    workers.push_back(std::move(worker));
+  }
+}
+
+Chip8SearchResult Chip8Search::run() {
+  if (!root) {
+    return {};
+  }
+  visited.insert(root->stateHash());
+  states = 1;
+  if (options.goal.reached(*root)) {
+    found = &start;
+    return result(&start);
+  }
+
+  if (options.mode == Chip8SearchMode::Breadth) {
+    // one level per round
+    vector<Node*> frontier{&start};
+    while (!frontier.empty() && !found && !exhausted &&
+           frontier[0]->depth < options.maxDepth) {
+      expand(frontier);
+      frontier.clear();
+      for (auto& worker : workers) {
+        frontier.insert(frontier.end(), worker->children.begin(),
+                        worker->children.end());
+        worker->children.clear();
+      }
+    }
+  } else {
+    // highest score first, then shallowest
+    auto ranking = [](const Node* a, const Node* b) {
+      return a->score != b->score ? a->score < b->score : a->depth > b->depth;
+    };
+    priority_queue<Node*, vector<Node*>, decltype(ranking)> queue(ranking);
+    queue.push(&start);
+    vector<Node*> batch;
+    while (!queue.empty() && !found && !exhausted) {
+      batch.clear();
+      while (!queue.empty() &&
+             batch.size() < workers.size() * CHIP8_SEARCH_BATCH) {
+        batch.push_back(queue.top());
+        queue.pop();
+      }
+      expand(batch);
+      for (auto& worker : workers) {
+        for (auto child : worker->children) {
+          if (child->depth < options.maxDepth) {
+            queue.push(child);
+          }
+        }
+        worker->children.clear();
+      }
+    }
+  }
+
+  if (found) {
+    return result(found);
+  }
+  const Node* best = &start;
+  for (auto& worker : workers) {
+    if (worker->best && worker->best->score > best->score) {
+      best = worker->best;
+    }
+  }
+  return result(best);
+}
+
+// Workers claim nodes from the batch in turn. Expanded nodes give their
+// machines back to the pool that owns them.
+void Chip8Search::expand(const vector<Node*>& batch) {
+  atomic<size_t> next{0};
+  auto work = [&](uint32_t owner) {
+    auto& worker = *workers[owner];
+    for (auto i = next++; i < batch.size() && !found && !exhausted;
+         i = next++) {
+      expand(worker, owner, *batch[i]);
+    }
+  };
+
+  vector<thread> threads;
+  auto count = std::min<size_t>(workers.size(), batch.size());
+  for (uint32_t owner = 1; owner < count; owner++) {
+    threads.emplace_back(work, owner);
+  }
+  work(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (auto node : batch) {
+    if (node->handle != CHIP8_NO_HANDLE) {
+      workers[node->owner]->pool->release(node->handle);
+      node->handle = CHIP8_NO_HANDLE;
+      node->machine = nullptr;
+    }
+  }
+}
+
+// Children are run in the worker's scratch machine, which becomes the
+// child's when its state was not seen before.
+void Chip8Search::expand(Worker& worker, uint32_t owner, const Node& node) {
+  for (int8_t input = CHIP8_SEARCH_NONE; input < CHIP8_KEYS; input++) {
+    if (found || exhausted) {
+      return;
+    }
+    auto& child = (*worker.pool)[worker.scratch];
+    node.machine->forkInto(child);
+    for (auto key = 0; key < CHIP8_KEYS; key++) {
+      child.keyboard[key] = key == input;
+    }
+    for (uint32_t frame = 0; frame < options.framesPerInput && !child.exited;
+         frame++) {
+      child.runFrame(options.cyclesPerFrame);
+    }
+
+    if (!visited.insert(child.stateHash())) {
+      duplicates++;
+      continue;
+    }
+    if (states++ >= options.maxStates) {
+      exhausted = true;
+      return;
+    }
+
+    worker.nodes.push_back({&child, &node, worker.scratch, owner,
+                            node.depth + 1, score(child), input});
+    auto added = &worker.nodes.back();
+    if (!worker.best || added->score > worker.best->score) {
+      worker.best = added;
+    }
+    worker.scratch = worker.pool->acquire(image);
+    if (worker.scratch == CHIP8_NO_HANDLE) {
+      exhausted = true;
+    }
+    if (options.goal.reached(child)) {
+      const Node* none = nullptr;
+      found.compare_exchange_strong(none, added);
+      return;
+    }
+    worker.children.push_back(added);
+  }
+}
+
+int64_t Chip8Search::score(const Chip8Machine& chip8) const {
+  if (options.maximize >= 0) {
+    return chip8.read(options.maximize);
+  }
+  return options.goal.met(chip8);
+}
+
+Chip8SearchResult Chip8Search::result(const Node* node) const {
+  Chip8SearchResult result;
+  result.found = node == found.load();
+  result.score = node->score;
+  result.depth = node->depth;
+  for (; node->parent; node = node->parent) {
+    result.inputs.push_back(node->input);
+  }
+  std::reverse(result.inputs.begin(), result.inputs.end());
+  result.states = std::min<uint64_t>(states, options.maxStates);
+  result.duplicates = duplicates;
+  return result;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "pool.hpp"
+
+#define CHIP8_SEARCH_INPUTS (CHIP8_KEYS + 1)
+#define CHIP8_SEARCH_NONE -1
+// best-first nodes expanded per worker and round
+#define CHIP8_SEARCH_BATCH 16
+// unexpanded states kept as machines across all workers, about 1 GB
+#define CHIP8_SEARCH_MACHINES (1 << 18)
+
+using std::atomic;
+using std::deque;
+using std::pair;
+using std::thread;
+
+// Lock-free set of state hashes: open addressing with linear probing, slots
+// are claimed with a compare-and-swap and never removed.
+class Chip8VisitedTable {
+ private:
+  Chip8VisitedTable(const Chip8VisitedTable&) = delete;
+  Chip8VisitedTable& operator=(const Chip8VisitedTable&) = delete;
+
+ public:
+  // room for at least capacity hashes
+  Chip8VisitedTable(size_t capacity);
+  ~Chip8VisitedTable() = default;
+
+  // false when the hash was already there or the table is full
+  bool insert(uint64_t hash);
+  size_t size() const;
+
+ private:
+  unique_ptr<atomic<uint64_t>[]> slots;
+  size_t mask;
+  atomic<size_t> count{0};
+};
+
+enum class Chip8SearchMode { Breadth, Best };
+
+// Every condition must hold: memory bytes equal to a value, pixels lit.
+struct Chip8SearchGoal {
+  vector<pair<uint16_t, uint8_t>> memory;
+  vector<pair<uint16_t, uint16_t>> pixels;
+
+  uint32_t met(const Chip8Machine& chip8) const;
+  bool reached(const Chip8Machine& chip8) const;
+};
+
+struct Chip8SearchOptions {
+  Chip8SearchMode mode = Chip8SearchMode::Breadth;
+  // 0 runs one worker per core
+  uint32_t threads = 0;
+  // each step holds one key, or none, for this many frames
+  uint32_t framesPerInput = 4;
+  // the emulator's default, CHIP8_CYCLES_PER_FRAME
+  uint32_t cyclesPerFrame = 10;
+  uint32_t maxDepth = 32;
+  // visited states, of which at most CHIP8_SEARCH_MACHINES wait unexpanded
+  uint32_t maxStates = 100000;
+  // best-first ranks states by this memory byte, or by goal conditions met
+  int32_t maximize = -1;
+  // Cxkk stream of the start state, see Chip8Machine::seedRandom(); the
+  // inputs found replay from a machine seeded the same way
+  uint64_t seed = 1;
+  Chip8SearchGoal goal;
+};
+
+// Without a goal, or when it was not found, the inputs lead to the best
+// scoring state.
+struct Chip8SearchResult {
+  bool found = false;
+  // key held at each step, CHIP8_SEARCH_NONE for no key
+  vector<int8_t> inputs;
+  int64_t score = 0;
+  uint64_t states = 0;
+  uint64_t duplicates = 0;
+  uint32_t depth = 0;
+};
+
+// Explores input sequences from a start state, breadth-first or best-first,
+// on all cores. Children are forks of their parent sharing its memory image
+// and are deduplicated by Chip8Machine::stateHash() in a lock-free table.
+// Not for MegaChip, whose screen the state hash does not cover.
+class Chip8Search {
+ private:
+  Chip8Search(const Chip8Search&) = delete;
+  Chip8Search& operator=(const Chip8Search&) = delete;
+
+ public:
+  Chip8Search(const Chip8Machine& start, const Chip8SearchOptions& options);
+  ~Chip8Search() = default;
+
+  Chip8SearchResult run();
+
+ private:
+  // A node keeps its machine until it is expanded, then only its path.
+  struct Node {
+    Chip8Machine* machine;
+    const Node* parent;
+    Chip8Handle handle;
+    uint32_t owner;
+    uint32_t depth;
+    int64_t score;
+    int8_t input;
+  };
+  struct Worker {
+    unique_ptr<Chip8Pool> pool;
+    Chip8Handle scratch;
+    deque<Node> nodes;
+    vector<Node*> children;
+    const Node* best = nullptr;
+  };
+
+  void expand(const vector<Node*>& batch);
+  void expand(Worker& worker, uint32_t owner, const Node& node);
+  int64_t score(const Chip8Machine& chip8) const;
+  Chip8SearchResult result(const Node* node) const;
+
+ private:
+  Chip8SearchOptions options;
+  shared_ptr<const Chip8MemoryImage> image;
+  unique_ptr<Chip8Machine> root;
+  Node start;
+  vector<unique_ptr<Worker>> workers;
+  Chip8VisitedTable visited;
+  atomic<uint64_t> states{0};
+  atomic<uint64_t> duplicates{0};
+  atomic<const Node*> found{nullptr};
+  atomic<bool> exhausted{false};
+};
@@ -0,0 +1,88 @@
+#include "shared.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+using std::cerr;
+using std::endl;
+
+static_assert(offsetof(chip8_shm, planes) % 8 == 0, "planes are aligned");
+static_assert(sizeof(chip8_shm::planes) == sizeof(Chip8Screen::planes),
+              "same plane layout as the core");
+static_assert(sizeof(chip8_shm::indexed) == sizeof(MegaChipScreen::pixels),
+              "same index layout as the core");
+
+Chip8SharedState::~Chip8SharedState() {
+  if (shm) {
+    munmap(shm, sizeof(chip8_shm));
+    shm_unlink(name.c_str());
+  }
+}
+
+// The segment must not exist yet: another emulator may be publishing to it
+// and its readers would silently switch over.
+bool Chip8SharedState::open(const string& segment) {
+  auto fd = shm_open(segment.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    if (errno == EEXIST) {
+      cerr << "shared memory " << segment
+           << " is in use, or left over: remove /dev/shm" << segment << endl;
+    }
+    return false;
+  }
+  auto mapped = MAP_FAILED;
+  if (ftruncate(fd, sizeof(chip8_shm)) == 0) {
+    mapped = mmap(nullptr, sizeof(chip8_shm), PROT_READ | PROT_WRITE,
+                  MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    shm_unlink(segment.c_str());
+    return false;
+  }
+
+  name = segment;
+  shm = static_cast<chip8_shm*>(mapped);
+  memset(shm, 0, sizeof(chip8_shm));
+  shm->magic = CHIP8_SHM_MAGIC;
+  shm->version = CHIP8_SHM_VERSION;
+  shm->size = sizeof(chip8_shm);
+  return true;
+}
+
+const chip8_shm* Chip8SharedState::data() const { return shm; }
+
+// Seqlock write: readers that saw the odd sequence or a different one retry.
+void Chip8SharedState::publish(const Chip8Machine& machine, uint64_t frame) {
+  if (!shm) {
+    return;
+  }
+  auto sequence = __atomic_load_n(&shm->sequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&shm->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  auto indexed = machine.mega && machine.mega->enabled;
+  shm->profile = uint32_t(machine.profile());
+  shm->frame = frame;
+  memcpy(shm->registers, machine.registers, sizeof(shm->registers));
+  memcpy(shm->stack, machine.stack, sizeof(shm->stack));
+  shm->index = machine.index;
+  shm->pc = machine.pc;
+  shm->sp = machine.sp;
+  shm->delay_timer = machine.delayTimer;
+  shm->sound_timer = machine.soundTimer;
+  shm->format = indexed ? CHIP8_SHM_INDEXED : CHIP8_SHM_PLANES;
+  shm->width = indexed ? MEGACHIP_WIDTH : machine.screen.width();
+  shm->height = indexed ? MEGACHIP_HEIGHT : machine.screen.height();
+  if (indexed) {
+    memcpy(shm->indexed, machine.mega->pixels, sizeof(shm->indexed));
+    memcpy(shm->palette, machine.mega->palette, sizeof(shm->palette));
+  } else {
+    memcpy(shm->planes, machine.screen.planes, sizeof(shm->planes));
+  }
+
+  __atomic_store_n(&shm->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
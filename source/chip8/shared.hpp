@@ -0,0 +1,27 @@
+#pragma once
+
+#include "chip8.hpp"
+#include "chip8shm.h"
+
+using std::string;
+
+// Writer side of the shared-memory export described in chip8shm.h. The
+// segment is created with shm_open and removed again on destruction.
+class Chip8SharedState {
+ private:
+  Chip8SharedState(const Chip8SharedState&) = delete;
+  Chip8SharedState& operator=(const Chip8SharedState&) = delete;
+
+ public:
+  Chip8SharedState() = default;
+  ~Chip8SharedState();
+
+  // name is a POSIX shared-memory name such as "/chip8"
+  bool open(const string& name);
+  void publish(const Chip8Machine& machine, uint64_t frame);
+  const chip8_shm* data() const;
+
+ private:
+  string name;
+  chip8_shm* shm = nullptr;
+};
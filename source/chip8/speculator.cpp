@@ -0,0 +1,99 @@
+#include "speculator.hpp"
+
+using std::lock_guard;
+using std::unique_lock;
+
+Chip8Speculator::Chip8Speculator(Chip8Profile profile, uint32_t threads)
+    : base(Chip8Machine::create(profile)),
+      threads(std::clamp<uint32_t>(threads, 1, CHIP8_SPECULATIONS)) {
+  for (auto i = 0; i < CHIP8_SPECULATIONS; i++) {
+    candidates.push_back(Chip8Machine::create(profile));
+  }
+  for (uint32_t worker = 0; worker < this->threads; worker++) {
+    workers.emplace_back(&Chip8Speculator::work, this, worker);
+  }
+}
+
+Chip8Speculator::~Chip8Speculator() {
+  {
+    lock_guard<mutex> guard{lock};
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void Chip8Speculator::speculate(const Chip8Machine& chip8, uint32_t cycles) {
+  wait();
+  chip8.forkInto(*base);
+  {
+    lock_guard<mutex> guard{lock};
+    this->cycles = cycles;
+    pending = threads;
+    generation++;
+    running = true;
+  }
+  wake.notify_all();
+}
+
+bool Chip8Speculator::adopt(const bool* keys, Chip8Machine& chip8) {
+  if (!running) {
+    return false;
+  }
+  wait();
+  running = false;
+
+  // candidate 0 keeps the input unchanged, candidate k + 1 toggles key k
+  auto candidate = 0;
+  for (auto key = 0; key < CHIP8_KEYS; key++) {
+    if (keys[key] != base->keyboard[key]) {
+      if (candidate != 0) {
+        missed++;
+        return false;
+      }
+      candidate = key + 1;
+    }
+  }
+
+  chip8.copyState(*candidates[candidate]);
+  adopted++;
+  return true;
+}
+
+uint64_t Chip8Speculator::hits() const { return adopted; }
+
+uint64_t Chip8Speculator::misses() const { return missed; }
+
+void Chip8Speculator::wait() {
+  unique_lock<mutex> guard{lock};
+  done.wait(guard, [this] { return pending == 0; });
+}
+
+void Chip8Speculator::work(uint32_t worker) {
+  uint64_t seen = 0;
+  unique_lock<mutex> guard{lock};
+  while (true) {
+    wake.wait(guard, [&] { return stopping || generation != seen; });
+    if (stopping) {
+      return;
+    }
+    seen = generation;
+    guard.unlock();
+
+    for (auto i = worker; i < CHIP8_SPECULATIONS; i += threads) {
+      auto& candidate = *candidates[i];
+      base->forkInto(candidate);
+      if (i > 0) {
+        candidate.keyboard[i - 1] = !candidate.keyboard[i - 1];
+      }
+      candidate.runFrame(cycles);
+    }
+
+    guard.lock();
+    if (--pending == 0) {
+      done.notify_all();
+    }
+  }
+}
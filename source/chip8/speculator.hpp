@@ -0,0 +1,48 @@
+#pragma once
+
+#include "chip8.hpp"
+
+#define CHIP8_SPECULATIONS (CHIP8_KEYS + 1)
+
+using std::condition_variable;
+using std::mutex;
+using std::thread;
+using std::unique_ptr;
+
+// Pre-executes the next frame on worker threads for the current input and
+// for every single key toggle, so the frame matching the real input can be
+// adopted instead of emulated.
+class Chip8Speculator {
+ private:
+  Chip8Speculator(const Chip8Speculator&) = delete;
+  Chip8Speculator& operator=(const Chip8Speculator&) = delete;
+
+ public:
+  Chip8Speculator(Chip8Profile profile, uint32_t threads);
+  ~Chip8Speculator();
+
+  void speculate(const Chip8Machine& chip8, uint32_t cycles);
+  bool adopt(const bool* keys, Chip8Machine& chip8);
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+ private:
+  void work(uint32_t worker);
+  void wait();
+
+ private:
+  unique_ptr<Chip8Machine> base;
+  vector<unique_ptr<Chip8Machine>> candidates;
+  vector<thread> workers;
+  mutex lock;
+  condition_variable wake;
+  condition_variable done;
+  uint64_t generation = 0;
+  uint32_t threads = 0;
+  uint32_t pending = 0;
+  uint32_t cycles = 0;
+  bool running = false;
+  bool stopping = false;
+  uint64_t adopted = 0;
+  uint64_t missed = 0;
+};
@@ -0,0 +1,334 @@
+#include "stream.hpp"
+
+#include "packbits.hpp"
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static void put8(vector<uint8_t>& out, uint8_t value) { out.push_back(value); }
+
+static void put16(vector<uint8_t>& out, uint16_t value) {
+  out.push_back(value & 0xff);
+  out.push_back(value >> 8);
+}
+
+static void put32(vector<uint8_t>& out, uint32_t value) {
+  put16(out, value & 0xffff);
+  put16(out, value >> 16);
+}
+
+static void put64(vector<uint8_t>& out, uint64_t value) {
+  put32(out, value & 0xffffffff);
+  put32(out, value >> 32);
+}
+
+static uint16_t get16(const uint8_t* in) { return in[0] | (in[1] << 8); }
+
+static uint32_t get32(const uint8_t* in) {
+  return get16(in) | (uint32_t(get16(in + 2)) << 16);
+}
+
+static uint64_t get64(const uint8_t* in) {
+  return get32(in) | (uint64_t(get32(in + 4)) << 32);
+}
+
+// unix:/path or tcp:port, the TCP socket only binds the loopback address
+static int openSocket(const string& address, sockaddr_storage& storage,
+                      socklen_t& length) {
+  memset(&storage, 0, sizeof(storage));
+  if (address.rfind("unix:", 0) == 0) {
+    auto name = address.substr(5);
+    auto& local = reinterpret_cast<sockaddr_un&>(storage);
+    if (name.empty() || name.size() >= sizeof(local.sun_path)) {
+      return -1;
+    }
+    local.sun_family = AF_UNIX;
+    memcpy(local.sun_path, name.c_str(), name.size());
+    length = sizeof(sockaddr_un);
+    return socket(AF_UNIX, SOCK_STREAM, 0);
+  }
+  if (address.rfind("tcp:", 0) == 0) {
+    auto port = atoi(address.c_str() + 4);
+    if (port <= 0 || port > 0xffff) {
+      return -1;
+    }
+    auto& inet = reinterpret_cast<sockaddr_in&>(storage);
+    inet.sin_family = AF_INET;
+    inet.sin_port = htons(port);
+    inet.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    length = sizeof(sockaddr_in);
+    return socket(AF_INET, SOCK_STREAM, 0);
+  }
+  return -1;
+}
+
+Chip8Streamer::~Chip8Streamer() {
+  for (auto client : clients) {
+    close(client);
+  }
+  for (auto client : joining) {
+    close(client);
+  }
+  if (server >= 0) {
+    close(server);
+  }
+  if (!path.empty()) {
+    unlink(path.c_str());
+  }
+}
+
+bool Chip8Streamer::listen(const string& address) {
+  sockaddr_storage storage;
+  socklen_t length = 0;
+  server = openSocket(address, storage, length);
+  if (server < 0) {
+    return false;
+  }
+  int reuse = 1;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  if (storage.ss_family == AF_UNIX) {
+    path = address.substr(5);
+    unlink(path.c_str());
+  }
+  if (bind(server, reinterpret_cast<sockaddr*>(&storage), length) != 0 ||
+      ::listen(server, CHIP8_STREAM_CLIENTS) != 0) {
+    close(server);
+    server = -1;
+    path.clear();
+    return false;
+  }
+  fcntl(server, F_SETFL, O_NONBLOCK);
+  return true;
+}
+
+int Chip8Streamer::connect(const string& address) {
+  sockaddr_storage storage;
+  socklen_t length = 0;
+  auto client = openSocket(address, storage, length);
+  if (client < 0) {
+    return -1;
+  }
+  if (::connect(client, reinterpret_cast<sockaddr*>(&storage), length) != 0) {
+    close(client);
+    return -1;
+  }
+  return client;
+}
+
+size_t Chip8Streamer::viewers() const {
+  return clients.size() + joining.size();
+}
+
+uint64_t Chip8Streamer::sentBytes() const { return sent; }
+
+// New viewers get the hello, publish() follows with a keyframe.
+void Chip8Streamer::accept() {
+  vector<uint8_t> hello;
+  put32(hello, CHIP8_STREAM_MAGIC);
+  put16(hello, CHIP8_STREAM_VERSION);
+  put16(hello, 0);
+  int client;
+  while (viewers() < CHIP8_STREAM_CLIENTS &&
+         (client = ::accept(server, nullptr, nullptr)) >= 0) {
+    fcntl(client, F_SETFL, O_NONBLOCK);
+    joining.push_back(client);
+  }
+  send(hello, joining);
+}
+
+// A partial send would corrupt the stream, such viewers are dropped.
+void Chip8Streamer::send(const vector<uint8_t>& message,
+                         vector<int>& targets) {
+  for (size_t i = 0; i < targets.size();) {
+    auto n = ::send(targets[i], message.data(), message.size(),
+                    MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n != ssize_t(message.size())) {
+      close(targets[i]);
+      targets.erase(targets.begin() + i);
+      continue;
+    }
+    sent += n;
+    i++;
+  }
+}
+
+void Chip8Streamer::publish(const Chip8Machine& machine, uint64_t timestamp) {
+  if (server < 0) {
+    return;
+  }
+  accept();
+
+  auto indexed = machine.mega && machine.mega->enabled;
+  uint16_t width = indexed ? MEGACHIP_WIDTH : machine.screen.width();
+  uint16_t height = indexed ? MEGACHIP_HEIGHT : machine.screen.height();
+  auto resized = width != lastWidth || height != lastHeight;
+  lastWidth = width;
+  lastHeight = height;
+
+  // every viewer needs a keyframe after a resolution change
+  sequence++;
+  if (resized && !clients.empty()) {
+    clients.insert(clients.end(), joining.begin(), joining.end());
+    joining = std::move(clients);
+    clients.clear();
+  }
+  if (!clients.empty()) {
+    encode(machine, sequence, timestamp, false, delta);
+    send(delta, clients);
+  }
+  if (!joining.empty()) {
+    encode(machine, sequence, timestamp, true, full);
+    send(full, joining);
+    clients.insert(clients.end(), joining.begin(), joining.end());
+    joining.clear();
+  }
+}
+
+void Chip8Streamer::encode(const Chip8Machine& machine, uint32_t sequence,
+                           uint64_t timestamp, bool keyframe,
+                           vector<uint8_t>& out) {
+  auto indexed = machine.mega && machine.mega->enabled;
+  uint16_t width = indexed ? MEGACHIP_WIDTH : machine.screen.width();
+  uint16_t height = indexed ? MEGACHIP_HEIGHT : machine.screen.height();
+  uint64_t dirty[CHIP8_DIRTY_WORDS] = {};
+  if (keyframe) {
+    memset(dirty, 0xff, sizeof(dirty));
+  } else {
+    machine.dirtyRows(dirty);
+  }
+
+  out.clear();
+  put32(out, 0);
+  put32(out, sequence);
+  put64(out, timestamp);
+  put16(out, width);
+  put16(out, height);
+  put8(out, uint8_t(indexed ? Chip8StreamFormat::Indexed
+                            : Chip8StreamFormat::Planes));
+  put8(out, keyframe ? 1 : 0);
+  auto countAt = out.size();
+  put16(out, 0);
+
+  uint16_t rows = 0;
+  uint8_t row[MEGACHIP_WIDTH];
+  for (uint16_t y = 0; y < height; y++) {
+    if (!((dirty[y >> 6] >> (y & 63)) & 1)) {
+      continue;
+    }
+    size_t size = width;
+    if (indexed) {
+      memcpy(row, machine.mega->pixels[y], width);
+    } else {
+      size = 0;
+      for (auto plane = 0; plane < XOCHIP_PLANES; plane++) {
+        for (auto word = 0; word < width / 64; word++) {
+          auto bits = machine.screen.planes[plane][y][word];
+          for (auto shift = 56; shift >= 0; shift -= 8) {
+            row[size++] = bits >> shift;
+          }
+        }
+      }
+    }
+    put16(out, y);
+    auto sizeAt = out.size();
+    put16(out, 0);
+    packBits(row, size, out);
+    auto encoded = out.size() - sizeAt - 2;
+    out[sizeAt] = encoded & 0xff;
+    out[sizeAt + 1] = encoded >> 8;
+    rows++;
+  }
+
+  out[countAt] = rows & 0xff;
+  out[countAt + 1] = rows >> 8;
+  auto size = out.size() - 4;
+  for (auto i = 0; i < 4; i++) {
+    out[i] = size >> (8 * i);
+  }
+}
+
+bool Chip8StreamDecoder::feed(const uint8_t* data, size_t size) {
+  pending.insert(pending.end(), data, data + size);
+  size_t offset = 0;
+  if (!greeted) {
+    if (pending.size() < CHIP8_STREAM_HELLO_SIZE) {
+      return true;
+    }
+    if (get32(pending.data()) != CHIP8_STREAM_MAGIC ||
+        get16(pending.data() + 4) != CHIP8_STREAM_VERSION) {
+      return false;
+    }
+    greeted = true;
+    offset = CHIP8_STREAM_HELLO_SIZE;
+  }
+
+  auto ok = true;
+  while (ok && pending.size() - offset >= 4) {
+    size_t length = get32(pending.data() + offset);
+    if (pending.size() - offset - 4 < length) {
+      break;
+    }
+    ok = decode(pending.data() + offset, length + 4);
+    offset += length + 4;
+  }
+  pending.erase(pending.begin(), pending.begin() + offset);
+  return ok;
+}
+
+bool Chip8StreamDecoder::decode(const uint8_t* message, size_t size) {
+  if (size < CHIP8_STREAM_HEADER_SIZE) {
+    return false;
+  }
+  auto frameWidth = get16(message + 16);
+  auto frameHeight = get16(message + 18);
+  auto frameFormat = Chip8StreamFormat(message[20]);
+  if (frameWidth > MEGACHIP_WIDTH || frameHeight > MEGACHIP_HEIGHT ||
+      frameWidth % 64 != 0) {
+    return false;
+  }
+  sequence = get32(message + 4);
+  timestamp = get64(message + 8);
+  width = frameWidth;
+  height = frameHeight;
+  format = frameFormat;
+
+  auto rows = get16(message + 22);
+  size_t offset = CHIP8_STREAM_HEADER_SIZE;
+  uint8_t row[MEGACHIP_WIDTH];
+  for (uint16_t i = 0; i < rows; i++) {
+    if (offset + 4 > size) {
+      return false;
+    }
+    auto y = get16(message + offset);
+    size_t length = get16(message + offset + 2);
+    offset += 4;
+    size_t capacity = format == Chip8StreamFormat::Indexed
+                          ? width
+                          : XOCHIP_PLANES * width / 8;
+    if (y >= height || offset + length > size ||
+        !unpackBits(message + offset, length, row, capacity)) {
+      return false;
+    }
+    offset += length;
+
+    if (format == Chip8StreamFormat::Indexed) {
+      memcpy(pixels[y], row, width);
+      continue;
+    }
+    for (uint16_t x = 0; x < width; x++) {
+      auto bit = 7 - (x & 7);
+      auto low = (row[x >> 3] >> bit) & 1;
+      auto high = (row[width / 8 + (x >> 3)] >> bit) & 1;
+      pixels[y][x] = low | (high << 1);
+    }
+  }
+  messages++;
+  return true;
+}
+
+uint8_t Chip8StreamDecoder::pixel(uint16_t x, uint16_t y) const {
+  return pixels[y][x];
+}
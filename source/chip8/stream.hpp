@@ -0,0 +1,106 @@
+#pragma once
+
+#include "chip8.hpp"
+
+#define CHIP8_STREAM_MAGIC 0x54533843  // "C8ST"
+#define CHIP8_STREAM_VERSION 1
+#define CHIP8_STREAM_HELLO_SIZE 8
+#define CHIP8_STREAM_HEADER_SIZE 24
+#define CHIP8_STREAM_CLIENTS 16
+
+using std::string;
+
+// Stream wire format, version 1. Integers are little-endian.
+//
+// On connect the server sends a hello:
+//   uint32 magic      CHIP8_STREAM_MAGIC
+//   uint16 version    CHIP8_STREAM_VERSION
+//   uint16 reserved
+// then one message per presented frame, the first one a keyframe:
+//   uint32 size       bytes following this field
+//   uint32 sequence   presented frame number, +1 per message
+//   uint64 timestamp  emulated time in 1/60 s frames
+//   uint16 width      pixels
+//   uint16 height     pixels
+//   uint8  format     Chip8StreamFormat
+//   uint8  flags      bit 0: keyframe, every row follows
+//   uint16 rows       row records following
+// and per changed row:
+//   uint16 row
+//   uint16 size       encoded bytes following
+//   the row in PackBits: a header byte n < 128 copies the next n + 1 bytes,
+//   n > 128 repeats the next byte 257 - n times, 128 is skipped. Planes
+//   rows are plane 0 then plane 1, width / 8 bytes each with the leftmost
+//   pixel in the high bit; indexed rows are one palette index per pixel.
+enum class Chip8StreamFormat : uint8_t { Planes, Indexed };
+
+// Publishes the changed rows of the core framebuffer to viewers connected
+// to a Unix socket ("unix:/path") or localhost TCP ("tcp:port"). Sends never
+// block: a viewer that cannot keep up is disconnected.
+class Chip8Streamer {
+ private:
+  Chip8Streamer(const Chip8Streamer&) = delete;
+  Chip8Streamer& operator=(const Chip8Streamer&) = delete;
+
+ public:
+  Chip8Streamer() = default;
+  ~Chip8Streamer();
+
+  bool listen(const string& address);
+  // the dirty rows of machine since the previous frame are sent
+  void publish(const Chip8Machine& machine, uint64_t timestamp);
+  size_t viewers() const;
+  uint64_t sentBytes() const;
+
+  static void encode(const Chip8Machine& machine, uint32_t sequence,
+                     uint64_t timestamp, bool keyframe, vector<uint8_t>& out);
+  // connected socket for a client, -1 on failure
+  static int connect(const string& address);
+
+ private:
+  void accept();
+  void send(const vector<uint8_t>& message, vector<int>& targets);
+
+ private:
+  int server = -1;
+  string path;
+  vector<int> clients;
+  vector<int> joining;
+  uint32_t sequence = 0;
+  uint64_t sent = 0;
+  uint16_t lastWidth = 0;
+  uint16_t lastHeight = 0;
+  vector<uint8_t> delta;
+  vector<uint8_t> full;
+};
+
+// Rebuilds the framebuffer of a stream, used by viewers and tests.
+class Chip8StreamDecoder {
+ private:
+  Chip8StreamDecoder(const Chip8StreamDecoder&) = delete;
+  Chip8StreamDecoder& operator=(const Chip8StreamDecoder&) = delete;
+
+ public:
+  Chip8StreamDecoder() = default;
+  ~Chip8StreamDecoder() = default;
+
+  // Consumes received bytes, returns false on a malformed stream
+  bool feed(const uint8_t* data, size_t size);
+  // palette index of a pixel, plane bits for the Planes format
+  uint8_t pixel(uint16_t x, uint16_t y) const;
+
+  uint32_t sequence = 0;
+  uint64_t timestamp = 0;
+  uint16_t width = 0;
+  uint16_t height = 0;
+  Chip8StreamFormat format = Chip8StreamFormat::Planes;
+  uint64_t messages = 0;
+
+ private:
+  bool decode(const uint8_t* message, size_t size);
+
+ private:
+  bool greeted = false;
+  vector<uint8_t> pending;
+  uint8_t pixels[MEGACHIP_HEIGHT][MEGACHIP_WIDTH] = {};
+};
@@ -1,17 +1,215 @@
 #include "chip8/emulator.hpp"
+#include "chip8/fanout.hpp"
+#include "chip8/recorder.hpp"
+#include "manager/raygrid.hpp"
 #include "manager/raymanager.hpp"
+#include "manager/terminalmanager.hpp"
 
 using std::cerr;
+using std::cout;
 using std::endl;
 
 int main(int argc, const char** argv) {
-  if (argc != 2) {
-    cerr << "Usage: chip8-emulator romfile" << endl;
+  if (argc < 2) {
+    cerr << "Usage: chip8-emulator "
+            "[--profile modern|cosmac|schip|xochip|megachip] [--deadline] "
+            "[--frameskip frames] [--run-ahead frames] [--speculate threads] "
+            "[--palette mono|octo|amber|green] [--rgb565] "
+            "[--blend frames | --decay persistence] [--grid instances] "
+            "[--terminal] [--record file.y4m|file.gif|file.raw] "
+            "[--frames count] [--stream unix:/path|tcp:port] "
+            "[--shm name] [--display] romfile"
+         << endl;
     return 0;
   }
-  RayManager* rayManager = new RayManager();
-  Chip8Emulator emulator{rayManager};
-  emulator.execute(argv[1]);
+
+  auto profile = Chip8Profile::Modern;
+  auto forceProfile = false;
+  auto sync = Chip8Sync::Audio;
+  uint32_t frameSkip = CHIP8_MAX_FRAMESKIP;
+  uint32_t runAhead = 0;
+  uint32_t speculation = 0;
+  const Chip8Palette* palette = nullptr;
+  auto format = Chip8PixelFormat::RGBA8888;
+  int blend = 0;
+  int decay = -1;
+  uint32_t instances = 0;
+  auto terminal = false;
+  auto display = false;
+  string record;
+  uint64_t frames = 0;
+  string stream;
+  string shm;
+  for (auto i = 1; i < argc - 1; i++) {
+    string option = argv[i];
+    if (option == "--profile" && i + 1 < argc - 1) {
+      string name = argv[++i];
+      forceProfile = true;
+      if (name == "cosmac") {
+        profile = Chip8Profile::Cosmac;
+      } else if (name == "schip") {
+        profile = Chip8Profile::SuperChip;
+      } else if (name == "xochip") {
+        profile = Chip8Profile::XoChip;
+      } else if (name == "megachip") {
+        profile = Chip8Profile::MegaChip;
+      }
+    } else if (option == "--deadline") {
+      sync = Chip8Sync::Deadline;
+    } else if (option == "--frameskip" && i + 1 < argc - 1) {
+      frameSkip = atoi(argv[++i]);
+    } else if (option == "--run-ahead" && i + 1 < argc - 1) {
+      runAhead = atoi(argv[++i]);
+    } else if (option == "--speculate" && i + 1 < argc - 1) {
+      speculation = atoi(argv[++i]);
+    } else if (option == "--palette" && i + 1 < argc - 1) {
+      palette = Chip8Palette::find(argv[++i]);
+      if (!palette) {
+        cerr << "unknown palette: " << argv[i] << endl;
+        return 0;
+      }
+    } else if (option == "--rgb565") {
+      format = Chip8PixelFormat::RGB565;
+    } else if (option == "--blend" && i + 1 < argc - 1) {
+      blend = atoi(argv[++i]);
+    } else if (option == "--decay" && i + 1 < argc - 1) {
+      decay = atoi(argv[++i]);
+    } else if (option == "--grid" && i + 1 < argc - 1) {
+      instances = atoi(argv[++i]);
+    } else if (option == "--terminal") {
+      terminal = true;
+    } else if (option == "--display") {
+      display = true;
+    } else if (option == "--record" && i + 1 < argc - 1) {
+      record = argv[++i];
+    } else if (option == "--frames" && i + 1 < argc - 1) {
+      frames = atoll(argv[++i]);
+    } else if (option == "--stream" && i + 1 < argc - 1) {
+      stream = argv[++i];
+    } else if (option == "--shm" && i + 1 < argc - 1) {
+      shm = argv[++i];
+    } else {
+      cerr << "unknown option: " << option << endl;
+      return 0;
+    }
+  }
+
+  auto configure = [&](Chip8Emulator& emulator) {
+    if (forceProfile) {
+      emulator.setProfile(profile);
+    }
+    emulator.setSync(sync);
+    emulator.setMaxFrameSkip(frameSkip);
+    emulator.setRunAhead(runAhead);
+    emulator.setSpeculation(speculation);
+    emulator.setPixelFormat(format);
+    if (palette) {
+      emulator.setPalette(*palette);
+    }
+    if (blend > 0) {
+      emulator.setBlend(blend);
+    } else if (decay >= 0) {
+      emulator.setDecay(std::min(decay, 255));
+    }
+  };
+
+  // one thread per instance, the window thread only draws the atlas
+  if (instances > 0) {
+    RayGrid grid{instances};
+    vector<thread> threads;
+    for (uint32_t n = 0; n < instances; n++) {
+      threads.emplace_back([&, n] {
+        Chip8Emulator emulator{grid.attach(n)};
+        configure(emulator);
+        emulator.execute(argv[argc - 1]);
+      });
+    }
+    while (grid.draw()) {
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    return 0;
+  }
+
+  // the window is the default sink, --display keeps it next to the others
+  vector<std::pair<Chip8HardwareManager*, Chip8SinkMode>> sinks;
+  auto window = display || (record.empty() && !terminal);
+  if (window) {
+    sinks.emplace_back(new RayManager(), Chip8SinkMode::Inline);
+  }
+  if (terminal) {
+    auto mode = window ? Chip8SinkMode::DropOldest : Chip8SinkMode::Inline;
+    sinks.emplace_back(new TerminalManager(), mode);
+  }
+  Chip8Recorder* recorder = nullptr;
+  if (!record.empty()) {
+    recorder = new Chip8Recorder(record, Chip8Recorder::formatOf(record),
+                                 frames);
+    if (!recorder->isOpen()) {
+      cerr << "cannot write " << record << endl;
+      delete recorder;
+      for (auto& sink : sinks) {
+        delete sink.first;
+      }
+      return 0;
+    }
+    // the recorder already encodes on its own thread
+    sinks.emplace_back(recorder, Chip8SinkMode::Inline);
+  }
+
+  Chip8HardwareManager* manager = sinks.front().first;
+  Chip8FanOut* fanout = nullptr;
+  if (sinks.size() > 1) {
+    fanout = new Chip8FanOut();
+    for (auto& sink : sinks) {
+      fanout->add(sink.first, sink.second);
+    }
+    manager = fanout;
+  }
+  Chip8Emulator emulator{manager};
+  configure(emulator);
+  if (!stream.empty() && !emulator.setStream(stream)) {
+    cerr << "cannot listen on " << stream << endl;
+    return 0;
+  }
+  if (!shm.empty() && !emulator.setSharedState(shm)) {
+    cerr << "cannot create shared memory " << shm << endl;
+    return 0;
+  }
+  emulator.execute(argv[argc - 1]);
+
+  auto& metrics = emulator.metrics();
+  if (recorder) {
+    cout << "record: " << recorder->duplicates() << " duplicate and "
+         << recorder->dropped() << " dropped frames" << endl;
+  }
+  if (fanout && terminal && window) {
+    cout << "terminal: " << fanout->dropped(1) << " dropped frames" << endl;
+  }
+  if (metrics.skippedFrames > 0) {
+    cout << "frameskip: " << metrics.skippedFrames << " of " << metrics.frames
+         << " frames not presented" << endl;
+  }
+  if (runAhead > 0 && metrics.emulationTime > 0) {
+    cout << "run-ahead: " << metrics.latencySaved << " ms latency saved, "
+         << 100.0 * metrics.runAheadTime / metrics.emulationTime
+         << "% extra emulation time" << endl;
+  }
+  if (speculation > 0) {
+    cout << "speculation: " << metrics.speculationHits << " frames adopted, "
+         << metrics.speculationMisses << " missed" << endl;
+  }
+  if (!stream.empty() && metrics.frames > 0) {
+    cout << "stream: "
+         << metrics.streamedBytes * CHIP8_FRAME_RATE / metrics.frames
+         << " bytes/s" << endl;
+  }
+  if (metrics.frames > 0) {
+    cout << "upload: "
+         << metrics.uploadedBytes * CHIP8_FRAME_RATE / metrics.frames
+         << " bytes/s" << endl;
+  }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -8,9 +8,11 @@
 #include <stdlib.h>
 
 #include <algorithm>
+#include <atomic>
 #include <bitset>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <functional>
 #include <iomanip>
@@ -18,10 +20,12 @@
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <random>
 #include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
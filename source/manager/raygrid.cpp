@@ -0,0 +1,140 @@
+#include "raygrid.hpp"
+
+using std::lock_guard;
+
+RayGrid::RayGrid(uint32_t count) {
+  count = std::max<uint32_t>(count, 1);
+  while (columns * columns < count) {
+    columns++;
+  }
+  rows = (count + columns - 1) / columns;
+  scale = std::max(1.0f, float(RAYGRID_WINDOW_WIDTH) /
+                             (columns * RAYGRID_TILE_WIDTH));
+  for (uint32_t n = 0; n < count; n++) {
+    tiles.push_back(std::make_unique<RayGridTile>());
+  }
+
+  auto width = columns * RAYGRID_TILE_WIDTH;
+  auto height = rows * RAYGRID_TILE_HEIGHT;
+  InitWindow(scale * width, scale * height, "CHIP-8 Monitor");
+  SetTargetFPS(60);
+  auto blank = GenImageColor(width, height, BLACK);
+  atlas = LoadTextureFromImage(blank);
+  UnloadImage(blank);
+}
+
+RayGrid::~RayGrid() {
+  if (IsTextureValid(atlas)) {
+    UnloadTexture(atlas);
+  }
+  CloseWindow();
+}
+
+Chip8HardwareManager* RayGrid::attach(uint32_t n) {
+  return new RayGridManager(*this, n);
+}
+
+bool RayGrid::running() const { return open; }
+
+static uint32_t toRGBA(uint16_t colour) {
+  uint32_t r = (colour >> 11) << 3;
+  uint32_t g = ((colour >> 5) & 0x3f) << 2;
+  uint32_t b = (colour & 0x1f) << 3;
+  return 0xff000000 | (b << 16) | (g << 8) | r;
+}
+
+// Frames are scaled to the tile by nearest sampling, a tile row is restaged
+// when the frame row it samples is dirty.
+uint64_t RayGrid::store(uint32_t n, const Chip8Frame& frame) {
+  if (n >= tiles.size()) {
+    return 0;
+  }
+  auto& tile = *tiles[n];
+  lock_guard<mutex> guard(tile.lock);
+  auto resized = tile.width != frame.width || tile.height != frame.height;
+  tile.width = frame.width;
+  tile.height = frame.height;
+
+  uint64_t staged = 0;
+  for (auto y = 0; y < RAYGRID_TILE_HEIGHT; y++) {
+    auto row = y * frame.height / RAYGRID_TILE_HEIGHT;
+    if (!resized && !((frame.dirty[row >> 6] >> (row & 63)) & 1)) {
+      continue;
+    }
+    auto out = tile.pixels + y * RAYGRID_TILE_WIDTH;
+    if (frame.format == Chip8PixelFormat::RGB565) {
+      auto in = static_cast<const uint16_t*>(frame.pixels) + row * frame.width;
+      for (auto x = 0; x < RAYGRID_TILE_WIDTH; x++) {
+        out[x] = toRGBA(in[x * frame.width / RAYGRID_TILE_WIDTH]);
+      }
+    } else if (frame.width == RAYGRID_TILE_WIDTH) {
+      auto in = static_cast<const uint32_t*>(frame.pixels) + row * frame.width;
+      memcpy(out, in, RAYGRID_TILE_WIDTH * sizeof(uint32_t));
+    } else {
+      auto in = static_cast<const uint32_t*>(frame.pixels) + row * frame.width;
+      for (auto x = 0; x < RAYGRID_TILE_WIDTH; x++) {
+        out[x] = in[x * frame.width / RAYGRID_TILE_WIDTH];
+      }
+    }
+    tile.dirty |= 1ull << y;
+    staged += RAYGRID_TILE_WIDTH * sizeof(uint32_t);
+  }
+  return staged;
+}
+
+bool RayGrid::draw() {
+  for (size_t n = 0; n < tiles.size(); n++) {
+    auto& tile = *tiles[n];
+    lock_guard<mutex> guard(tile.lock);
+    float left = (n % columns) * RAYGRID_TILE_WIDTH;
+    float top = (n / columns) * RAYGRID_TILE_HEIGHT;
+    for (auto y = 0; y < RAYGRID_TILE_HEIGHT;) {
+      if (!((tile.dirty >> y) & 1)) {
+        y++;
+        continue;
+      }
+      auto first = y;
+      while (y < RAYGRID_TILE_HEIGHT && ((tile.dirty >> y) & 1)) {
+        y++;
+      }
+      Rectangle span = {
+          .x = left,
+          .y = top + first,
+          .width = float(RAYGRID_TILE_WIDTH),
+          .height = float(y - first),
+      };
+      UpdateTextureRec(atlas, span, tile.pixels + first * RAYGRID_TILE_WIDTH);
+    }
+    tile.dirty = 0;
+  }
+
+  Rectangle src = {
+      .x = 0.0f,
+      .y = 0.0f,
+      .width = float(atlas.width),
+      .height = float(atlas.height),
+  };
+  Rectangle dst = {
+      .x = 0.0f,
+      .y = 0.0f,
+      .width = scale * atlas.width,
+      .height = scale * atlas.height,
+  };
+  Vector2 origin{.x = 0.0f, .y = 0.0f};
+  BeginDrawing();
+  ClearBackground(BLACK);
+  DrawTexturePro(atlas, src, dst, origin, 0.0f, WHITE);
+  EndDrawing();
+
+  open = !WindowShouldClose();
+  return open;
+}
+
+RayGridManager::RayGridManager(RayGrid& owner, uint32_t n)
+    : grid(owner), tile(n) {}
+
+uint64_t RayGridManager::display(const Chip8Frame& frame) {
+  return grid.store(tile, frame);
+}
+
+bool RayGridManager::handleKeys(bool*) { return grid.running(); }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "chip8/emulator.hpp"
+#include "pch.h"
+
+#define RAYGRID_TILE_WIDTH 128
+#define RAYGRID_TILE_HEIGHT 64
+#define RAYGRID_WINDOW_WIDTH 1280
+
+using std::atomic;
+using std::mutex;
+using std::unique_ptr;
+using std::vector;
+
+// Staging copy of one instance's frame, scaled to the tile size. Written by
+// the instance thread, uploaded by the window thread.
+struct RayGridTile {
+  mutex lock;
+  uint32_t pixels[RAYGRID_TILE_WIDTH * RAYGRID_TILE_HEIGHT] = {};
+  // bit n is set when tile row n changed since the last upload
+  uint64_t dirty = ~0ull;
+  uint16_t width = 0;
+  uint16_t height = 0;
+};
+
+// Monitoring window for many instances: every instance is a tile of a single
+// atlas texture, created once. Dirty tile rows are uploaded and the whole
+// atlas is drawn with one draw call per frame.
+class RayGrid {
+ private:
+  RayGrid(const RayGrid&) = delete;
+  RayGrid& operator=(const RayGrid&) = delete;
+
+ public:
+  RayGrid(uint32_t count);
+  ~RayGrid();
+
+  // Manager of tile n for one emulator, owned by the caller
+  Chip8HardwareManager* attach(uint32_t n);
+  // Window thread only, returns false once the window is closed
+  bool draw();
+  bool running() const;
+  uint64_t store(uint32_t n, const Chip8Frame& frame);
+
+ private:
+  uint32_t columns = 1;
+  uint32_t rows = 1;
+  float scale = 1.0f;
+  vector<unique_ptr<RayGridTile>> tiles;
+  Texture2D atlas{};
+  atomic<bool> open{true};
+};
+
+// Chip8HardwareManager of one grid tile. Frames go to the tile, there is no
+// keyboard or audio.
+class RayGridManager : public Chip8HardwareManager {
+ private:
+  RayGridManager(const RayGridManager&) = delete;
+  RayGridManager& operator=(const RayGridManager&) = delete;
+
+ public:
+  RayGridManager(RayGrid& owner, uint32_t n);
+  virtual ~RayGridManager() = default;
+
+  virtual uint64_t display(const Chip8Frame& frame) override;
+  virtual bool handleKeys(bool* keys) override;
+
+ private:
+  RayGrid& grid;
+  uint32_t tile;
+};
@@ -8,36 +8,116 @@ RayManager::RayManager() {
   SetTargetFPS(60);
 }
 
-RayManager::~RayManager() { CloseWindow(); }
+RayManager::~RayManager() {
+  if (IsTextureValid(texture)) {
+    UnloadTexture(texture);
+  }
+  if (audioRing) {
+    UnloadAudioStream(stream);
+    CloseAudioDevice();
+    audioRing = nullptr;
+  }
+  CloseWindow();
+}
+
+uint64_t RayManager::display(const Chip8Frame& frame) {
+  auto uploaded = upload(frame);
 
-void RayManager::display(const int32_t* video) {
   Rectangle src = {
       .x = 0.0f,
       .y = 0.0f,
-      .width = CHIP8_VIDEO_WIDTH,
-      .height = CHIP8_VIDEO_HEIGHT,
+      .width = float(frame.width),
+      .height = float(frame.height),
   };
 
+  // largest size that keeps the frame's aspect ratio, centred: MegaChip's
+  // 4:3 frame is pillarboxed in the 2:1 window
+  auto scale = std::min(float(GetScreenWidth()) / frame.width,
+                        float(GetScreenHeight()) / frame.height);
   Rectangle dst = {
-      .x = 0.0f,
-      .y = 0.0f,
-      .width = 10.0f * CHIP8_VIDEO_WIDTH,
-      .height = 10.0f * CHIP8_VIDEO_HEIGHT,
+      .x = (GetScreenWidth() - scale * frame.width) / 2,
+      .y = (GetScreenHeight() - scale * frame.height) / 2,
+      .width = scale * frame.width,
+      .height = scale * frame.height,
   };
   Vector2 origin{.x = 0.0f, .y = 0.0f};
-  Image screen = {
-      .data = (void*)video,
-      .width = CHIP8_VIDEO_WIDTH,
-      .height = CHIP8_VIDEO_HEIGHT,
-      .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
-      .mipmaps = 1,
-  };
-  auto texture = LoadTextureFromImage(screen);
   BeginDrawing();
   ClearBackground(BLACK);
   DrawTexturePro(texture, src, dst, origin, 0.0f, WHITE);
   EndDrawing();
-  UnloadTexture(texture);
+  return uploaded;
+}
+
+// The texture is kept between frames, only spans of consecutive dirty rows
+// are uploaded. It is recreated when the size or pixel format changes.
+uint64_t RayManager::upload(const Chip8Frame& frame) {
+  auto bpp = frame.format == Chip8PixelFormat::RGB565 ? 2 : 4;
+  uint64_t stride = frame.width * bpp;
+  if (!IsTextureValid(texture) || texture.width != frame.width ||
+      texture.height != frame.height || format != frame.format) {
+    if (IsTextureValid(texture)) {
+      UnloadTexture(texture);
+    }
+    Image screen = {
+        .data = (void*)frame.pixels,
+        .width = frame.width,
+        .height = frame.height,
+        .mipmaps = 1,
+        .format = bpp == 2 ? PIXELFORMAT_UNCOMPRESSED_R5G6B5
+                           : PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+    };
+    texture = LoadTextureFromImage(screen);
+    format = frame.format;
+    return stride * frame.height;
+  }
+
+  auto dirty = [&frame](int row) {
+    return (frame.dirty[row >> 6] >> (row & 63)) & 1;
+  };
+  uint64_t uploaded = 0;
+  auto pixels = static_cast<const uint8_t*>(frame.pixels);
+  for (auto row = 0; row < frame.height;) {
+    if (!dirty(row)) {
+      row++;
+      continue;
+    }
+    auto first = row;
+    while (row < frame.height && dirty(row)) {
+      row++;
+    }
+    Rectangle span = {
+        .x = 0.0f,
+        .y = float(first),
+        .width = float(frame.width),
+        .height = float(row - first),
+    };
+    UpdateTextureRec(texture, span, pixels + first * stride);
+    uploaded += (row - first) * stride;
+  }
+  return uploaded;
+}
+
+AudioRing* RayManager::audioRing = nullptr;
+
+bool RayManager::openAudio(AudioRing* ring) {
+  InitAudioDevice();
+  if (!IsAudioDeviceReady()) {
+    CloseAudioDevice();
+    return false;
+  }
+
+  SetAudioStreamBufferSizeDefault(CHIP8_AUDIO_PERIOD);
+  stream = LoadAudioStream(CHIP8_AUDIO_SAMPLE_RATE, 16, 1);
+  audioRing = ring;
+  SetAudioStreamCallback(stream, streamAudio);
+  PlayAudioStream(stream);
+  return true;
+}
+
+void RayManager::streamAudio(void* buffer, unsigned int frames) {
+  auto samples = static_cast<int16_t*>(buffer);
+  auto n = audioRing->read(samples, frames);
+  memset(samples + n, 0, (frames - n) * sizeof(int16_t));
 }
 
 bool RayManager::handleKeys(bool* keys) {
@@ -48,103 +128,103 @@ bool RayManager::handleKeys(bool* keys) {
 }
 
 void RayManager::handleKeysUp(bool* keys) {
-  if (IsKeyDown(KEY_KP_1)) {
-    keys[0] = true;
+  if (IsKeyUp(KEY_KP_1)) {
+    keys[0] = false;
   }
-  if (IsKeyDown(KEY_KP_2)) {
-    keys[1] = true;
+  if (IsKeyUp(KEY_KP_2)) {
+    keys[1] = false;
   }
-  if (IsKeyDown(KEY_KP_3)) {
-    keys[2] = true;
+  if (IsKeyUp(KEY_KP_3)) {
+    keys[2] = false;
   }
-  if (IsKeyDown(KEY_KP_4)) {
-    keys[3] = true;
+  if (IsKeyUp(KEY_KP_4)) {
+    keys[3] = false;
   }
-  if (IsKeyDown(KEY_Q)) {
-    keys[4] = true;
+  if (IsKeyUp(KEY_Q)) {
+    keys[4] = false;
   }
-  if (IsKeyDown(KEY_W)) {
-    keys[5] = true;
+  if (IsKeyUp(KEY_W)) {
+    keys[5] = false;
   }
-  if (IsKeyDown(KEY_E)) {
-    keys[6] = true;
+  if (IsKeyUp(KEY_E)) {
+    keys[6] = false;
   }
-  if (IsKeyDown(KEY_R)) {
-    keys[7] = true;
+  if (IsKeyUp(KEY_R)) {
+    keys[7] = false;
   }
-  if (IsKeyDown(KEY_A)) {
-    keys[8] = true;
+  if (IsKeyUp(KEY_A)) {
+    keys[8] = false;
   }
-  if (IsKeyDown(KEY_S)) {
-    keys[9] = true;
+  if (IsKeyUp(KEY_S)) {
+    keys[9] = false;
   }
-  if (IsKeyDown(KEY_D)) {
-    keys[10] = true;
+  if (IsKeyUp(KEY_D)) {
+    keys[10] = false;
   }
-  if (IsKeyDown(KEY_F)) {
-    keys[11] = true;
+  if (IsKeyUp(KEY_F)) {
+    keys[11] = false;
   }
-  if (IsKeyDown(KEY_Z)) {
-    keys[12] = true;
+  if (IsKeyUp(KEY_Z)) {
+    keys[12] = false;
   }
-  if (IsKeyDown(KEY_X)) {
-    keys[13] = true;
+  if (IsKeyUp(KEY_X)) {
+    keys[13] = false;
   }
-  if (IsKeyDown(KEY_C)) {
-    keys[14] = true;
+  if (IsKeyUp(KEY_C)) {
+    keys[14] = false;
   }
-  if (IsKeyDown(KEY_V)) {
-    keys[15] = true;
+  if (IsKeyUp(KEY_V)) {
+    keys[15] = false;
   }
 }
 
 void RayManager::handleKeysDown(bool* keys) {
   if (IsKeyDown(KEY_KP_1)) {
-    keys[0] = false;
+    keys[0] = true;
   }
   if (IsKeyDown(KEY_KP_2)) {
-    keys[1] = false;
+    keys[1] = true;
   }
   if (IsKeyDown(KEY_KP_3)) {
-    keys[2] = false;
+    keys[2] = true;
   }
   if (IsKeyDown(KEY_KP_4)) {
-    keys[3] = false;
+    keys[3] = true;
   }
   if (IsKeyDown(KEY_Q)) {
-    keys[4] = false;
+    keys[4] = true;
   }
   if (IsKeyDown(KEY_W)) {
-    keys[5] = false;
+    keys[5] = true;
   }
   if (IsKeyDown(KEY_E)) {
-    keys[6] = false;
+    keys[6] = true;
   }
   if (IsKeyDown(KEY_R)) {
-    keys[7] = false;
+    keys[7] = true;
   }
   if (IsKeyDown(KEY_A)) {
-    keys[8] = false;
+    keys[8] = true;
   }
   if (IsKeyDown(KEY_S)) {
-    keys[9] = false;
+    keys[9] = true;
   }
   if (IsKeyDown(KEY_D)) {
-    keys[10] = false;
+    keys[10] = true;
   }
   if (IsKeyDown(KEY_F)) {
-    keys[11] = false;
+    keys[11] = true;
   }
   if (IsKeyDown(KEY_Z)) {
-    keys[12] = false;
+    keys[12] = true;
   }
   if (IsKeyDown(KEY_X)) {
-    keys[13] = false;
+    keys[13] = true;
   }
   if (IsKeyDown(KEY_C)) {
-    keys[14] = false;
+    keys[14] = true;
   }
   if (IsKeyDown(KEY_V)) {
-    keys[15] = false;
+    keys[15] = true;
   }
 }
\ No newline at end of file
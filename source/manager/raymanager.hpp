@@ -12,13 +12,20 @@ class RayManager : public Chip8HardwareManager {
   RayManager();
   virtual ~RayManager();
 
-  virtual void display(const int32_t* video) override;
+  virtual uint64_t display(const Chip8Frame& frame) override;
   virtual bool handleKeys(bool* keys) override;
+  virtual bool openAudio(AudioRing* ring) override;
 
  private:
   void handleKeysUp(bool* keys);
   void handleKeysDown(bool* keys);
+  static void streamAudio(void* buffer, unsigned int frames);
+  uint64_t upload(const Chip8Frame& frame);
 
  private:
   int32_t pitch = CHIP8_VIDEO_WIDTH * sizeof(int32_t);
+  AudioStream stream{};
+  Texture2D texture{};
+  Chip8PixelFormat format = Chip8PixelFormat::RGBA8888;
+  static AudioRing* audioRing;
 };
\ No newline at end of file
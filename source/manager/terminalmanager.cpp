@@ -0,0 +1,168 @@
+#include "terminalmanager.hpp"
+
+#include <ctype.h>
+#include <unistd.h>
+
+// same layout as RayManager: 1234 / QWER / ASDF / ZXCV
+static const char keyLayout[CHIP8_KEYS + 1] = "1234qwerasdfzxcv";
+
+TerminalManager::TerminalManager() {
+  if (tcgetattr(STDIN_FILENO, &saved) == 0) {
+    auto mode = saved;
+    mode.c_lflag &= ~(ICANON | ECHO | ISIG);
+    mode.c_iflag &= ~(IXON | ICRNL);
+    mode.c_cc[VMIN] = 0;
+    mode.c_cc[VTIME] = 0;
+    raw = tcsetattr(STDIN_FILENO, TCSANOW, &mode) == 0;
+  }
+  // hide the cursor and clear the screen
+  output = "\x1b[?25l\x1b[2J";
+  flush();
+}
+
+TerminalManager::~TerminalManager() {
+  output = "\x1b[0m\x1b[?25h";
+  moveTo(0, rows);
+  output += "\n";
+  flush();
+  if (raw) {
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+  }
+}
+
+void TerminalManager::flush() {
+  size_t done = 0;
+  while (done < output.size()) {
+    auto n = write(STDOUT_FILENO, output.data() + done, output.size() - done);
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+  }
+  output.clear();
+}
+
+uint32_t TerminalManager::colour(const Chip8Frame& frame, uint16_t x,
+                                 uint16_t y) const {
+  if (y >= frame.height) {
+    return 0;
+  }
+  auto i = y * frame.width + x;
+  if (frame.format == Chip8PixelFormat::RGB565) {
+    auto pixel = static_cast<const uint16_t*>(frame.pixels)[i];
+    return ((pixel >> 11) << 3) | (((pixel >> 5) & 0x3f) << 10) |
+           ((pixel & 0x1f) << 19);
+  }
+  return static_cast<const uint32_t*>(frame.pixels)[i] & 0x00ffffff;
+}
+
+// Cursor addressing is skipped when the cell follows the last one written.
+void TerminalManager::moveTo(uint16_t column, uint16_t row) {
+  if (column == cursorColumn && row == cursorRow) {
+    return;
+  }
+  char buffer[32];
+  auto n = snprintf(buffer, sizeof(buffer), "\x1b[%u;%uH", row + 1u,
+                    column + 1u);
+  output.append(buffer, n);
+  cursorColumn = column;
+  cursorRow = row;
+}
+
+void TerminalManager::setColours(const Cell& cell) {
+  char buffer[64];
+  int n = 0;
+  if (!penValid || cell.top != pen.top) {
+    n += snprintf(buffer + n, sizeof(buffer) - n, "\x1b[38;2;%u;%u;%um",
+                  cell.top & 0xff, (cell.top >> 8) & 0xff, cell.top >> 16);
+  }
+  if (!penValid || cell.bottom != pen.bottom) {
+    n += snprintf(buffer + n, sizeof(buffer) - n, "\x1b[48;2;%u;%u;%um",
+                  cell.bottom & 0xff, (cell.bottom >> 8) & 0xff,
+                  cell.bottom >> 16);
+  }
+  output.append(buffer, n);
+  pen = cell;
+  penValid = true;
+}
+
+// Wide frames are sampled every step pixels so they fit in
+// TERMINAL_MAX_COLUMNS. Returns the number of bytes written.
+uint64_t TerminalManager::display(const Chip8Frame& frame) {
+  auto width = std::max<uint16_t>(frame.width, 1);
+  uint16_t sampling =
+      (width + TERMINAL_MAX_COLUMNS - 1) / TERMINAL_MAX_COLUMNS;
+  uint16_t frameColumns = width / sampling;
+  uint16_t frameRows = (frame.height / sampling + 1) / 2;
+  auto resized = frameColumns != columns || frameRows != rows;
+  if (resized) {
+    step = sampling;
+    columns = frameColumns;
+    rows = frameRows;
+    cells.assign(size_t(columns) * rows, Cell{});
+    output = "\x1b[0m\x1b[2J";
+    penValid = false;
+    cursorColumn = -1;
+  } else {
+    output.clear();
+  }
+
+  auto dirty = [&frame](uint16_t y) {
+    return y < frame.height && ((frame.dirty[y >> 6] >> (y & 63)) & 1);
+  };
+  for (uint16_t row = 0; row < rows; row++) {
+    uint16_t top = 2 * row * step;
+    uint16_t bottom = top + step;
+    if (!resized && !dirty(top) && !dirty(bottom)) {
+      continue;
+    }
+    for (uint16_t column = 0; column < columns; column++) {
+      auto x = column * step;
+      Cell cell{colour(frame, x, top), colour(frame, x, bottom)};
+      auto& previous = cells[row * columns + column];
+      if (!resized && cell.top == previous.top &&
+          cell.bottom == previous.bottom) {
+        continue;
+      }
+      previous = cell;
+      moveTo(column, row);
+      setColours(cell);
+      output += "▀";
+      cursorColumn++;
+    }
+  }
+
+  auto written = output.size();
+  flush();
+  return written;
+}
+
+bool TerminalManager::handleKeys(bool* keys) {
+  for (auto key = 0; key < CHIP8_KEYS; key++) {
+    if (held[key] > 0) {
+      held[key]--;
+    }
+  }
+
+  auto run = true;
+  char buffer[64];
+  ssize_t n;
+  while ((n = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+    for (auto i = 0; i < n; i++) {
+      if (buffer[i] == 0x03) {
+        run = false;
+      }
+      // tolower() is only defined for unsigned char values and EOF
+      auto lower = tolower(static_cast<unsigned char>(buffer[i]));
+      auto key = strchr(keyLayout, lower);
+      if (key && *key) {
+        held[key - keyLayout] = TERMINAL_KEY_HOLD;
+      }
+    }
+  }
+
+  for (auto key = 0; key < CHIP8_KEYS; key++) {
+    keys[key] = held[key] > 0;
+  }
+  return run;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <termios.h>
+
+#include "chip8/emulator.hpp"
+#include "pch.h"
+
+#define TERMINAL_MAX_COLUMNS 128
+// terminals report key presses only, a key stays down this many frames
+#define TERMINAL_KEY_HOLD 6
+
+using std::string;
+using std::vector;
+
+// Renders frames to an ANSI terminal with upper half blocks, each cell shows
+// two pixel rows as foreground and background colours. Only the cells that
+// changed since the previous frame are written. Keys come from stdin in raw
+// mode, Ctrl-C quits.
+class TerminalManager : public Chip8HardwareManager {
+ private:
+  TerminalManager(const TerminalManager&) = delete;
+  TerminalManager& operator=(const TerminalManager&) = delete;
+
+ public:
+  TerminalManager();
+  virtual ~TerminalManager();
+
+  virtual uint64_t display(const Chip8Frame& frame) override;
+  virtual bool handleKeys(bool* keys) override;
+
+ private:
+  struct Cell {
+    uint32_t top;
+    uint32_t bottom;
+  };
+
+  uint32_t colour(const Chip8Frame& frame, uint16_t x, uint16_t y) const;
+  void moveTo(uint16_t column, uint16_t row);
+  void setColours(const Cell& cell);
+  void flush();
+
+ private:
+  termios saved{};
+  bool raw = false;
+  uint16_t columns = 0;
+  uint16_t rows = 0;
+  uint16_t step = 1;
+  vector<Cell> cells;
+  string output;
+  int32_t cursorColumn = -1;
+  int32_t cursorRow = -1;
+  Cell pen{};
+  bool penValid = false;
+  uint8_t held[CHIP8_KEYS] = {};
+};
@@ -0,0 +1,69 @@
+#include "chip8/rompack.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::ifstream;
+using std::filesystem::directory_iterator;
+
+// Builds a ROM pack from every regular file of a directory, or lists one.
+int main(int argc, const char** argv) {
+  if (argc < 3) {
+    cerr << "Usage: chip8-rompack [--compress] directory pack" CHIP8_PACK_SUFFIX
+         << endl
+         << "       chip8-rompack --list pack" CHIP8_PACK_SUFFIX << endl;
+    return 0;
+  }
+
+  if (string(argv[1]) == "--list") {
+    Chip8ROMPack pack;
+    if (!pack.open(argv[2])) {
+      cerr << "cannot open " << argv[2] << endl;
+      return 1;
+    }
+    for (uint32_t i = 0; i < pack.count(); i++) {
+      auto entry = pack.entry(i);
+      cout << std::hex << std::setw(16) << std::setfill('0') << entry->hash
+           << std::dec << " " << std::setw(6) << std::setfill(' ')
+           << entry->size << " " << pack.name(*entry) << endl;
+    }
+    return 0;
+  }
+
+  auto compress = string(argv[1]) == "--compress";
+  string directory = argv[argc - 2];
+  string output = argv[argc - 1];
+  std::error_code error;
+  vector<std::filesystem::path> files;
+  for (auto& file : directory_iterator(directory, error)) {
+    if (file.is_regular_file()) {
+      files.push_back(file.path());
+    }
+  }
+  if (error) {
+    cerr << "cannot read " << directory << ": " << error.message() << endl;
+    return 1;
+  }
+
+  // sorted so the same directory always gives the same pack
+  std::sort(files.begin(), files.end());
+  Chip8ROMPackBuilder builder;
+  uint32_t count = 0;
+  for (auto& file : files) {
+    ifstream rom{file, std::ios::binary};
+    vector<uint8_t> image{std::istreambuf_iterator<char>(rom),
+                          std::istreambuf_iterator<char>()};
+    auto name = file.filename().string();
+    if (!builder.add(name, image)) {
+      cerr << "skipping " << name << endl;
+      continue;
+    }
+    count++;
+  }
+  if (!builder.write(output, compress)) {
+    cerr << "cannot write " << output << endl;
+    return 1;
+  }
+  cout << count << " ROMs packed into " << output << endl;
+  return 0;
+}
@@ -0,0 +1,124 @@
+#include "chip8/loader.hpp"
+#include "chip8/search.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+// Searches the input sequences of a ROM for a memory or screen condition.
+int main(int argc, const char** argv) {
+  if (argc < 2) {
+    cerr << "Usage: chip8-search [--best] [--threads count] "
+            "[--hold frames] [--cycles count] [--depth steps] "
+            "[--states count] [--memory address=value] [--pixel x,y] "
+            "[--maximize address] [--seed number] "
+            "[--profile modern|cosmac|schip|xochip] romfile"
+         << endl;
+    return 1;
+  }
+
+  Chip8SearchOptions options;
+  auto profile = Chip8Profile::Modern;
+  auto forceProfile = false;
+  auto forceCycles = false;
+  for (auto i = 1; i < argc - 1; i++) {
+    string option = argv[i];
+    if (option == "--best") {
+      options.mode = Chip8SearchMode::Best;
+    } else if (option == "--threads" && i + 1 < argc - 1) {
+      options.threads = atoi(argv[++i]);
+    } else if (option == "--hold" && i + 1 < argc - 1) {
+      options.framesPerInput = std::max(1, atoi(argv[++i]));
+    } else if (option == "--cycles" && i + 1 < argc - 1) {
+      options.cyclesPerFrame = atoi(argv[++i]);
+      forceCycles = true;
+    } else if (option == "--depth" && i + 1 < argc - 1) {
+      options.maxDepth = atoi(argv[++i]);
+    } else if (option == "--states" && i + 1 < argc - 1) {
+      options.maxStates = atoi(argv[++i]);
+    } else if (option == "--memory" && i + 1 < argc - 1) {
+      // address=value, either may be hexadecimal with 0x
+      char* value;
+      auto address = strtol(argv[++i], &value, 0);
+      if (*value != '=') {
+        cerr << "expected address=value: " << argv[i] << endl;
+        return 1;
+      }
+      options.goal.memory.emplace_back(address, strtol(value + 1, nullptr, 0));
+    } else if (option == "--pixel" && i + 1 < argc - 1) {
+      char* y;
+      auto x = strtol(argv[++i], &y, 0);
+      if (*y != ',') {
+        cerr << "expected x,y: " << argv[i] << endl;
+        return 1;
+      }
+      options.goal.pixels.emplace_back(x, strtol(y + 1, nullptr, 0));
+    } else if (option == "--maximize" && i + 1 < argc - 1) {
+      options.maximize = strtol(argv[++i], nullptr, 0);
+    } else if (option == "--seed" && i + 1 < argc - 1) {
+      options.seed = strtoull(argv[++i], nullptr, 0);
+    } else if (option == "--profile" && i + 1 < argc - 1) {
+      string name = argv[++i];
+      forceProfile = true;
+      if (name == "cosmac") {
+        profile = Chip8Profile::Cosmac;
+      } else if (name == "schip") {
+        profile = Chip8Profile::SuperChip;
+      } else if (name == "xochip") {
+        profile = Chip8Profile::XoChip;
+      } else if (name != "modern") {
+        cerr << "unknown profile: " << name << endl;
+        return 1;
+      }
+    } else {
+      cerr << "unknown option: " << option << endl;
+      return 1;
+    }
+  }
+
+  ROMLoader romLoader{};
+  if (!romLoader.readROM(argv[argc - 1])) {
+    cerr << "cannot read " << argv[argc - 1] << endl;
+    return 1;
+  }
+  auto& rom = romLoader.info();
+  if (!forceProfile) {
+    profile = rom.profile;
+  }
+  if (!forceCycles) {
+    options.cyclesPerFrame = rom.cyclesPerFrame;
+  }
+  if (profile == Chip8Profile::MegaChip) {
+    cerr << "MegaChip ROMs cannot be searched" << endl;
+    return 1;
+  }
+
+  auto chip8 = Chip8Machine::create(profile);
+  FontLoader fontLoader{};
+  fontLoader.loadFont(*chip8);
+  if (!romLoader.copyROM(*chip8)) {
+    cerr << "ROM too large for the profile" << endl;
+    return 1;
+  }
+
+  auto started = std::chrono::steady_clock::now();
+  Chip8Search search{*chip8, options};
+  auto result = search.run();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - started;
+
+  cout << (result.found ? "found" : "best") << " at depth " << result.depth
+       << ", score " << result.score << ":";
+  for (auto input : result.inputs) {
+    if (input == CHIP8_SEARCH_NONE) {
+      cout << " -";
+    } else {
+      cout << " " << std::hex << int(input) << std::dec;
+    }
+  }
+  cout << endl
+       << result.states << " states, " << result.duplicates
+       << " duplicates in " << elapsed.count() << " s" << endl;
+  auto goal = !options.goal.memory.empty() || !options.goal.pixels.empty();
+  return goal && !result.found ? 2 : 0;
+}
@@ -0,0 +1,67 @@
+#include <unistd.h>
+
+#include "chip8/stream.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+// Reference viewer for the frame stream: rebuilds the screen from the deltas
+// and prints it as text ten times per emulated second.
+int main(int argc, const char** argv) {
+  if (argc < 2) {
+    cerr << "Usage: chip8-stream-client unix:/path|tcp:port" << endl;
+    return 0;
+  }
+
+  auto client = Chip8Streamer::connect(argv[1]);
+  if (client < 0) {
+    cerr << "cannot connect to " << argv[1] << endl;
+    return 1;
+  }
+
+  Chip8StreamDecoder decoder;
+  uint8_t buffer[4096];
+  uint64_t received = 0;
+  uint64_t shown = 0;
+  uint64_t first = 0;
+  const char shades[] = " #+*";
+  ssize_t n;
+  while ((n = read(client, buffer, sizeof(buffer))) > 0) {
+    received += n;
+    if (!decoder.feed(buffer, n)) {
+      cerr << "malformed stream" << endl;
+      break;
+    }
+    if (decoder.messages == 0) {
+      continue;
+    }
+    if (first == 0) {
+      first = decoder.timestamp;
+    }
+    if (decoder.timestamp < shown + 6) {
+      continue;
+    }
+    shown = decoder.timestamp;
+    auto elapsed = std::max<uint64_t>(decoder.timestamp - first, 1);
+
+    // MegaChip frames are sampled every other pixel to fit the terminal
+    auto step = decoder.width > 128 ? 2 : 1;
+    string screen = "\x1b[H";
+    for (auto y = 0; y < decoder.height; y += 2 * step) {
+      for (auto x = 0; x < decoder.width; x += step) {
+        auto index = decoder.pixel(x, y);
+        if (decoder.format == Chip8StreamFormat::Indexed) {
+          index = index ? 1 : 0;
+        }
+        screen += shades[index & 3];
+      }
+      screen += '\n';
+    }
+    cout << screen << "sequence " << decoder.sequence << ", frame "
+         << decoder.timestamp << ", " << received * 60 / elapsed
+         << " bytes/s   " << std::flush;
+  }
+  close(client);
+  return 0;
+}
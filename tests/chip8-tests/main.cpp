@@ -1,11 +1,67 @@
 #include <gtest/gtest.h>
+#include <unistd.h>
 
+#include "chip8/audio.hpp"
 #include "chip8/chip8.hpp"
+#include "chip8/emulator.hpp"
+#include "chip8/environment.hpp"
+#include "chip8/fanout.hpp"
 #include "chip8/loader.hpp"
-
+#include "chip8/pool.hpp"
+#include "chip8/presenter.hpp"
+#include "chip8/recorder.hpp"
+#include "chip8/romdb.hpp"
+#include "chip8/rompack.hpp"
+#include "chip8/search.hpp"
+#include "chip8/shared.hpp"
+#include "chip8/speculator.hpp"
+#include "chip8/stream.hpp"
+
+using std::ifstream;
 using std::ios;
 using std::ofstream;
 
+class SlowManager : public Chip8HardwareManager {
+ public:
+  SlowManager(uint32_t frames) : frames(frames) {}
+
+  virtual uint64_t display(const Chip8Frame&) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return 0;
+  }
+  virtual bool handleKeys(bool*) override { return --frames > 0; }
+
+ private:
+  uint32_t frames = 0;
+};
+
+// Records the dirty rows it is shown, blocks in display until opened.
+struct GatedSink {
+  std::atomic<bool> open{true};
+  std::atomic<bool> entered{false};
+  std::atomic<uint32_t> frames{0};
+  std::atomic<uint64_t> rows{0};
+};
+
+class GatedManager : public Chip8HardwareManager {
+ public:
+  GatedManager(GatedSink& sink) : sink(sink) {}
+
+  virtual uint64_t display(const Chip8Frame& frame) override {
+    sink.entered = true;
+    while (!sink.open) {
+      std::this_thread::yield();
+    }
+    sink.frames++;
+    sink.rows |= frame.dirty[0];
+    return 1;
+  }
+  virtual bool handleKeys(bool*) override { return true; }
+
+ private:
+  GatedSink& sink;
+};
+
 TEST(Chip8, Opcode0x00e0) {
   // arrange
   Chip8 cpu;
@@ -19,8 +75,10 @@ TEST(Chip8, Opcode0x00e0) {
   cpu.execute();
 
   // assert
-  for (auto pixel : cpu.video) {
-    ASSERT_EQ(pixel, 0);
+  for (auto y = 0; y < CHIP8_VIDEO_HEIGHT; y++) {
+    for (auto x = 0; x < CHIP8_VIDEO_WIDTH; x++) {
+      ASSERT_FALSE(cpu.screen.pixel(x, y));
+    }
   }
 }
 
@@ -443,7 +501,7 @@ TEST(Chip8, Opcode0xbnnn) {
   cpu.execute();
 
   // assert
-  ASSERT_EQ(cpu.index, 0x65f);
+  ASSERT_EQ(cpu.pc, 0x65f);
 }
 
 TEST(Chip8, Opcode0xcxkk) {
@@ -471,19 +529,20 @@ TEST(Chip8, Opcode0xd) {
 
   cpu.setMemory(CHIP8_MEMORY_START, code);
   cpu.setMemory(cpu.index, sprite);
-  cpu.video[0x44] = 0xffffffff;
+  cpu.setVideo(0x44, {1});
   // act
   cpu.execute();
 
   // assert
-  ASSERT_EQ(cpu.video[0x41], 0xffffffff);
-  ASSERT_EQ(cpu.video[0x42], 0xffffffff);
-  ASSERT_EQ(cpu.video[0x43], 0xffffffff);
-  ASSERT_EQ(cpu.video[0x44], 0x0);
-  ASSERT_EQ(cpu.video[0x45], 0xffffffff);
-  ASSERT_EQ(cpu.video[0x46], 0xffffffff);
-  ASSERT_EQ(cpu.video[0x47], 0xffffffff);
-  ASSERT_EQ(cpu.video[0x48], 0xffffffff);
+  ASSERT_TRUE(cpu.screen.pixel(1, 1));
+  ASSERT_TRUE(cpu.screen.pixel(2, 1));
+  ASSERT_TRUE(cpu.screen.pixel(3, 1));
+  ASSERT_FALSE(cpu.screen.pixel(4, 1));
+  ASSERT_TRUE(cpu.screen.pixel(5, 1));
+  ASSERT_TRUE(cpu.screen.pixel(6, 1));
+  ASSERT_TRUE(cpu.screen.pixel(7, 1));
+  ASSERT_TRUE(cpu.screen.pixel(8, 1));
+  ASSERT_FALSE(cpu.screen.pixel(9, 1));
   ASSERT_EQ(cpu.registers[0xf], 0x1);
 }
 
@@ -733,78 +792,1732 @@ TEST(Chip8, Opcode0xfx65) {
   ASSERT_EQ(cpu.memory[cpu.index + 7], cpu.registers[0x7]);
 }
 
-TEST(Chip8, EmulatorLoadFailure1) {
+TEST(Chip8, QuirkShiftUsesVy) {
   // arrange
-  Chip8 cpu;
-  ROMLoader loader{};
+  Chip8<CosmacQuirks> cpu;
+  vector<uint8_t> code{0x85, 0x66};
+  cpu.registers[0x5] = 0x2f;
+  cpu.registers[0x6] = 0x80;
+
+  cpu.setMemory(CHIP8_MEMORY_START, code);
 
   // act
-  auto result = loader.loadROM(cpu, "invalid_rom.ch8");
+  cpu.execute();
 
   // assert
-  ASSERT_EQ(result, false);
+  ASSERT_EQ(cpu.registers[0x5], 0x40);
+  ASSERT_EQ(cpu.registers[0xf], 0x0);
 }
 
-TEST(Chip8, EmulatorLoadFailure2) {
+TEST(Chip8, QuirkLogicResetsVF) {
   // arrange
-  Chip8 cpu;
-  ROMLoader loader{};
-  ofstream rom{"invalid_rom.ch8", ios::out | ios::binary};
-  rom.close();
+  Chip8<CosmacQuirks> cpu;
+  vector<uint8_t> code{0x85, 0x61};
+  cpu.registers[0x5] = 0x20;
+  cpu.registers[0x6] = 0x40;
+  cpu.registers[0xf] = 0x1;
+
+  cpu.setMemory(CHIP8_MEMORY_START, code);
 
   // act
-  auto result = loader.loadROM(cpu, "invalid_rom.ch8");
+  cpu.execute();
 
   // assert
-  ASSERT_EQ(result, false);
+  ASSERT_EQ(cpu.registers[0x5], 0x60);
+  ASSERT_EQ(cpu.registers[0xf], 0x0);
 }
 
-TEST(Chip8, EmulatorLoadFailure3) {
+TEST(Chip8, QuirkIncrementsIndex) {
+  // arrange
+  Chip8<CosmacQuirks> cpu;
+  vector<uint8_t> code{0xf2, 0x65};
+  vector<uint8_t> values{0x10, 0x11, 0x12};
+  cpu.index = 0x900;
+
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setMemory(cpu.index, values);
+
+  // act
+  cpu.execute();
+
+  // assert
+  ASSERT_EQ(cpu.registers[0x0], 0x10);
+  ASSERT_EQ(cpu.registers[0x2], 0x12);
+  ASSERT_EQ(cpu.index, 0x903);
+}
+
+TEST(Chip8, QuirkJumpUsesVx) {
+  // arrange
+  Chip8<SuperChipQuirks> cpu;
+  vector<uint8_t> code{0xb5, 0x6f};
+  cpu.registers[0x0] = 0xf0;
+  cpu.registers[0x5] = 0x01;
+
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+
+  // act
+  cpu.execute();
+
+  // assert
+  ASSERT_EQ(cpu.pc, 0x570);
+}
+
+TEST(Chip8, QuirkClipSprites) {
   // arrange
   Chip8 cpu;
+  vector<uint8_t> code{0xd5, 0x62};
+  vector<uint8_t> sprite{0xff, 0xff};
+  cpu.index = 0x900;
+  cpu.registers[0x5] = CHIP8_VIDEO_WIDTH - 4;
+  cpu.registers[0x6] = CHIP8_VIDEO_HEIGHT - 1;
+
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setMemory(cpu.index, sprite);
+
+  // act
+  cpu.execute();
+
+  // assert
+  auto last = CHIP8_VIDEO_HEIGHT - 1;
+  ASSERT_TRUE(cpu.screen.pixel(CHIP8_VIDEO_WIDTH - 1, last));
+  ASSERT_FALSE(cpu.screen.pixel(0, last));
+  ASSERT_FALSE(cpu.screen.pixel(0, 0));
+  ASSERT_FALSE(cpu.screen.pixel(CHIP8_VIDEO_WIDTH - 4, 0));
+}
+
+TEST(Chip8, SuperChipHires) {
+  // arrange
+  Chip8<SuperChipQuirks> cpu;
+  vector<uint8_t> code{0x00, 0xff, 0xd5, 0x62};  // high, drw v5, v6, 2
+  vector<uint8_t> sprite{0xff, 0x81};
+  cpu.index = 0x900;
+  cpu.registers[0x5] = CHIP8_HIRES_WIDTH - 4;
+  cpu.registers[0x6] = CHIP8_HIRES_HEIGHT - 2;
+
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setMemory(cpu.index, sprite);
+  cpu.setVideo(0, {1});
+
+  // act
+  cpu.execute();
+  cpu.execute();
+
+  // assert
+  ASSERT_TRUE(cpu.screen.hires);
+  ASSERT_EQ(cpu.screen.width(), CHIP8_HIRES_WIDTH);
+  ASSERT_FALSE(cpu.screen.pixel(0, 0));
+  ASSERT_TRUE(cpu.screen.pixel(CHIP8_HIRES_WIDTH - 4, CHIP8_HIRES_HEIGHT - 2));
+  ASSERT_TRUE(cpu.screen.pixel(CHIP8_HIRES_WIDTH - 1, CHIP8_HIRES_HEIGHT - 2));
+  ASSERT_TRUE(cpu.screen.pixel(CHIP8_HIRES_WIDTH - 4, CHIP8_HIRES_HEIGHT - 1));
+  ASSERT_FALSE(cpu.screen.pixel(CHIP8_HIRES_WIDTH - 3, CHIP8_HIRES_HEIGHT - 1));
+  ASSERT_FALSE(cpu.screen.pixel(0, CHIP8_HIRES_HEIGHT - 2));
+  ASSERT_EQ(cpu.registers[0xf], 0);
+}
+
+TEST(Chip8, SuperChipSprite16) {
+  // arrange
+  Chip8<SuperChipQuirks> cpu;
+  vector<uint8_t> code{0x00, 0xff, 0xd5, 0x60};  // high, drw v5, v6, 0
+  vector<uint8_t> sprite(32, 0xff);
+  cpu.index = 0x900;
+  cpu.registers[0x5] = 60;
+  cpu.registers[0x6] = 2;
+
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setMemory(cpu.index, sprite);
+
+  // act
+  cpu.execute();
+  cpu.execute();
+
+  // assert
+  ASSERT_FALSE(cpu.screen.pixel(59, 2));
+  ASSERT_TRUE(cpu.screen.pixel(60, 2));
+  ASSERT_TRUE(cpu.screen.pixel(63, 2));
+  ASSERT_TRUE(cpu.screen.pixel(64, 2));
+  ASSERT_TRUE(cpu.screen.pixel(75, 17));
+  ASSERT_FALSE(cpu.screen.pixel(76, 17));
+  ASSERT_FALSE(cpu.screen.pixel(60, 18));
+}
+
+TEST(Chip8, SuperChipScroll) {
+  // arrange
+  Chip8<SuperChipQuirks> cpu;
+  vector<uint8_t> code{0x00, 0xff, 0x00, 0xc3, 0x00, 0xfb, 0x00, 0xfc};
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+
+  // act
+  cpu.execute();
+  cpu.setVideo(62, {1, 1, 1, 1});
+  cpu.execute();
+  auto down = cpu.screen.pixel(62, 3) && !cpu.screen.pixel(62, 0);
+  cpu.execute();
+  auto right = cpu.screen.pixel(66, 3) && cpu.screen.pixel(69, 3) &&
+               !cpu.screen.pixel(65, 3);
+  cpu.execute();
+
+  // assert
+  ASSERT_TRUE(down);
+  ASSERT_TRUE(right);
+  ASSERT_TRUE(cpu.screen.pixel(62, 3));
+  ASSERT_TRUE(cpu.screen.pixel(65, 3));
+  ASSERT_FALSE(cpu.screen.pixel(66, 3));
+}
+
+TEST(Chip8, SuperChipScrollLores) {
+  // arrange
+  Chip8<SuperChipQuirks> cpu;
+  vector<uint8_t> code{0x00, 0xfb};  // scroll right
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setVideo(CHIP8_VIDEO_WIDTH - 2, {1, 1});
+
+  // act
+  cpu.execute();
+
+  // assert
+  ASSERT_FALSE(cpu.screen.hires);
+  ASSERT_FALSE(cpu.screen.pixel(CHIP8_VIDEO_WIDTH - 1, 0));
+  ASSERT_EQ(cpu.screen.planes[0][0][1], 0);
+}
+
+TEST(Chip8, SuperChipBigFont) {
+  // arrange
+  Chip8<SuperChipQuirks> cpu;
+  vector<uint8_t> code{0xf3, 0x30};  // ld hf, v3
+  cpu.registers[0x3] = 0x7;
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+
+  // act
+  cpu.execute();
+
+  // assert
+  ASSERT_EQ(cpu.index, CHIP8_BIG_FONTS_START + 7 * CHIP8_BIG_FONT_SIZE);
+}
+
+TEST(Chip8, SuperChipFlags) {
+  // arrange
+  Chip8<SuperChipQuirks> cpu;
+  vector<uint8_t> code{0xf2, 0x75, 0x60, 0x00, 0x61, 0x00,
+                       0x62, 0x00, 0xf1, 0x85};
+  cpu.registers[0x0] = 0x11;
+  cpu.registers[0x1] = 0x22;
+  cpu.registers[0x2] = 0x33;
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+
+  // act
+  for (auto i = 0; i < 5; i++) {
+    cpu.execute();
+  }
+
+  // assert
+  ASSERT_EQ(cpu.flags[0x2], 0x33);
+  ASSERT_EQ(cpu.registers[0x0], 0x11);
+  ASSERT_EQ(cpu.registers[0x1], 0x22);
+  ASSERT_EQ(cpu.registers[0x2], 0x00);
+}
+
+TEST(Chip8, SuperChipExit) {
+  // arrange
+  Chip8<SuperChipQuirks> cpu;
+  Chip8 modern;
+  vector<uint8_t> code{0x00, 0xfd};  // exit
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  modern.setMemory(CHIP8_MEMORY_START, code);
+
+  // act
+  cpu.runFrame(5);
+  modern.execute();
+
+  // assert
+  ASSERT_TRUE(cpu.exited);
+  ASSERT_EQ(cpu.pc, CHIP8_MEMORY_START);
+  ASSERT_FALSE(modern.exited);
+  ASSERT_EQ(modern.pc, CHIP8_MEMORY_START + 2);
+}
+
+TEST(Chip8, XoChipLongIndex) {
+  // arrange
+  Chip8<XoChipQuirks> cpu;
+  vector<uint8_t> code{0x30, 0x00, 0xf0, 0x00, 0x12, 0x34,
+                       0x60, 0x01, 0xf0, 0x00, 0xab, 0xcd};
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+
+  // act
+  cpu.execute();
+  auto skipped = cpu.pc;
+  cpu.execute();
+  cpu.execute();
+
+  // assert
+  ASSERT_EQ(skipped, CHIP8_MEMORY_START + 6);
+  ASSERT_EQ(cpu.index, 0xabcd);
+  ASSERT_EQ(cpu.pc, CHIP8_MEMORY_START + 12);
+}
+
+TEST(Chip8, XoChipPlanes) {
+  // arrange
+  Chip8<XoChipQuirks> cpu;
+  vector<uint8_t> code{0xf3, 0x01, 0xd5, 0x61, 0xf2, 0x01, 0x00, 0xe0};
+  vector<uint8_t> sprites{0xc0, 0x80};
+  cpu.index = 0x900;
+  cpu.registers[0x5] = 0x2;
+  cpu.registers[0x6] = 0x3;
+
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setMemory(cpu.index, sprites);
+
+  // act
+  cpu.execute();
+  cpu.execute();
+  auto both = cpu.screen.pixel(2, 3);
+  auto first = cpu.screen.pixel(3, 3);
+  cpu.execute();
+  cpu.execute();
+
+  // assert
+  ASSERT_EQ(both, 3);
+  ASSERT_EQ(first, 1);
+  ASSERT_EQ(cpu.screen.pixel(2, 3), 1);
+  ASSERT_EQ(cpu.screen.pixel(3, 3), 1);
+}
+
+TEST(Chip8, XoChipRegisterRange) {
+  // arrange
+  Chip8<XoChipQuirks> cpu;
+  vector<uint8_t> code{0x53, 0x12, 0x56, 0x83};  // save v3-v1, load v6-v8
+  cpu.index = 0x900;
+  cpu.registers[0x1] = 0x11;
+  cpu.registers[0x2] = 0x22;
+  cpu.registers[0x3] = 0x33;
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+
+  // act
+  cpu.execute();
+  cpu.execute();
+
+  // assert
+  ASSERT_EQ(cpu.memory[0x900], 0x33);
+  ASSERT_EQ(cpu.memory[0x902], 0x11);
+  ASSERT_EQ(cpu.registers[0x6], 0x33);
+  ASSERT_EQ(cpu.registers[0x8], 0x11);
+  ASSERT_EQ(cpu.index, 0x900);
+}
+
+TEST(Chip8, XoChipScrollUp) {
+  // arrange
+  Chip8<XoChipQuirks> cpu;
+  vector<uint8_t> code{0x00, 0xd2};  // scroll up 2
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setVideo(5 * CHIP8_VIDEO_WIDTH, {1});
+
+  // act
+  cpu.execute();
+
+  // assert
+  ASSERT_TRUE(cpu.screen.pixel(0, 3));
+  ASSERT_FALSE(cpu.screen.pixel(0, 5));
+}
+
+TEST(Chip8, XoChipMemory) {
+  // arrange
+  Chip8<XoChipQuirks> cpu;
+  Chip8 modern;
   ROMLoader loader{};
-  ofstream rom{"invalid_rom.ch8", ios::out | ios::binary};
+  ofstream rom{"large_rom.ch8", ios::out | ios::binary};
   char opcode = 0x00;
-  for (auto i = 0; i < CHIP8_MEMORY_SIZE; i++) {
+  for (auto i = 0; i < 2 * CHIP8_MEMORY_SIZE; i++) {
     rom.write(&opcode, 1);
   }
   rom.close();
 
   // act
-  auto result = loader.loadROM(cpu, "invalid_rom.ch8");
+  auto xochip = loader.loadROM(cpu, "large_rom.ch8");
+  auto chip8 = loader.loadROM(modern, "large_rom.ch8");
 
   // assert
-  ASSERT_EQ(result, false);
+  ASSERT_EQ(cpu.memorySize(), XOCHIP_MEMORY_SIZE);
+  ASSERT_EQ(xochip, true);
+  ASSERT_EQ(chip8, false);
 }
 
-TEST(Chip8, EmulatorLoadSuccess) {
+TEST(Chip8, MemoryWrap) {
   // arrange
-  Chip8 cpu;
+  Chip8<CosmacQuirks> cpu;
+  vector<uint8_t> code{0xf1, 0x1e,   // add i, v1
+                       0xf1, 0x55};  // ld [i], v1
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.index = 0xff0;
+  cpu.registers[0] = 0x2a;
+  cpu.registers[1] = 0x0f;
+
+  // act
+  cpu.execute();
+  cpu.execute();
+
+  // assert
+  ASSERT_EQ(cpu.footprint(), Chip8Machine::instanceSize(Chip8Profile::Cosmac) +
+                                 CHIP8_MEMORY_SIZE);
+  ASSERT_EQ(cpu.index, 0x001);
+  ASSERT_EQ(cpu.read(0xfff), 0x2a);
+  ASSERT_EQ(cpu.read(0x000), 0x0f);
+  ASSERT_EQ(cpu.read(0x1000), 0x0f);
+}
+
+TEST(Chip8, MegaChipLargeROM) {
+  // arrange
+  Chip8<MegaChipQuirks> cpu;
+  Chip8<XoChipQuirks> xochip;
   ROMLoader loader{};
-  ofstream rom{"valid_rom.ch8", ios::out | ios::binary};
-  char opcode = 0x00e0;
-  for (auto i = 0; i < 8; i++) {
-    rom.write(reinterpret_cast<const char*>(&opcode), 2);
-  }
+  vector<uint8_t> image(4 * XOCHIP_MEMORY_SIZE, 0);
+  image.back() = 0x2a;
+  ofstream rom{"mega_rom.ch8", ios::out | ios::binary};
+  rom.write(reinterpret_cast<const char*>(image.data()), image.size());
   rom.close();
+  Chip8ROMPackBuilder builder;
 
   // act
-  auto result = loader.loadROM(cpu, "valid_rom.ch8");
+  auto mega = loader.loadROM(cpu, "mega_rom.ch8");
+  auto small = loader.copyROM(xochip);
+  auto packed = builder.add("mega_rom.ch8", image);
 
   // assert
-  ASSERT_EQ(result, true);
+  ASSERT_TRUE(mega);
+  ASSERT_EQ(cpu.memory[CHIP8_MEMORY_START + image.size() - 1], 0x2a);
+  ASSERT_FALSE(small);
+  ASSERT_TRUE(packed);
 }
 
-TEST(Chip8, FontLoader) {
+TEST(Chip8, MegaChipMemoryWrap) {
   // arrange
-  Chip8 cpu;
-  FontLoader loader{};
+  Chip8<MegaChipQuirks> cpu;
+  vector<uint8_t> code{0x01, 0xff, 0xff, 0xf8,   // ldhi i, 0xfffff8
+                       0xff, 0x55,               // ld [i], vf
+                       0x60, 0x00,               // ld v0, 0
+                       0xff, 0x65};              // ld vf, [i]
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  for (auto i = 0; i < CHIP8_REGS; i++) {
+    cpu.registers[i] = 0x10 + i;
+  }
 
   // act
-  loader.loadFont(cpu);
+  for (auto i = 0; i < 4; i++) {
+    cpu.execute();
+  }
 
   // assert
-  ASSERT_EQ(cpu.memory[CHIP8_FONTS_START], loader.getFont(0, 0));
-  ASSERT_EQ(cpu.memory[CHIP8_FONTS_START + CHIP8_FONTS * CHIP8_FONT_SIZE - 1],
-            loader.getFont(0xf, 0x4));
-}
\ No newline at end of file
+  ASSERT_EQ(cpu.memory[0xfffff8], 0x10);
+  ASSERT_EQ(cpu.memory[0xffffff], 0x17);
+  ASSERT_EQ(cpu.memory[0x000000], 0x18);
+  ASSERT_EQ(cpu.memory[0x000007], 0x1f);
+  ASSERT_EQ(cpu.registers[0x0], 0x10);
+  ASSERT_EQ(cpu.registers[0xf], 0x1f);
+}
+
+TEST(Chip8, MegaChipSprite) {
+  // arrange
+  Chip8<MegaChipQuirks> cpu;
+  vector<uint8_t> code{0x00, 0x11, 0x03, 0x14, 0x04, 0x02, 0x09, 0x07,
+                       0x01, 0x01, 0x00, 0x00, 0xd5, 0x60};
+  vector<uint8_t> sprite(40, 0x03);
+  sprite[1] = 0x00;
+  sprite[19] = 0x00;
+  cpu.registers[0x5] = 10;
+  cpu.registers[0x6] = 4;
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  memcpy(cpu.memory + 0x10000, sprite.data(), sprite.size());
+  cpu.mega->pixels[4][11] = 0x07;
+
+  // act
+  for (auto i = 0; i < 6; i++) {
+    cpu.execute();
+  }
+
+  // assert
+  ASSERT_TRUE(cpu.mega->enabled);
+  ASSERT_EQ(cpu.index, 0x10000);
+  ASSERT_EQ(cpu.mega->pixels[4][10], 0x03);
+  ASSERT_EQ(cpu.mega->pixels[4][11], 0x00);
+  ASSERT_EQ(cpu.mega->pixels[4][29], 0x00);
+  ASSERT_EQ(cpu.mega->pixels[5][29], 0x03);
+  ASSERT_EQ(cpu.mega->pixels[6][10], 0x00);
+  ASSERT_EQ(cpu.registers[0xf], 0);
+}
+
+TEST(Chip8, MegaChipCollision) {
+  // arrange
+  MegaChipScreen screen;
+  screen.reset();
+  vector<uint8_t> sprite(24, 0x01);
+  screen.collision = 0x07;
+  screen.pixels[0][2] = 0x07;
+
+  // act
+  auto first = screen.blit(sprite.data(), 24, 1, 0, 0);
+  auto second = screen.blit(sprite.data(), 24, 1, 0, 0);
+  screen.pixels[0][20] = 0x07;
+  auto tail = screen.blit(sprite.data(), 24, 1, 0, 0);
+  auto clipped = screen.blit(sprite.data(), 24, 1, MEGACHIP_WIDTH - 8, 0);
+
+  // assert
+  ASSERT_TRUE(first);
+  ASSERT_FALSE(second);
+  ASSERT_TRUE(tail);
+  ASSERT_FALSE(clipped);
+  ASSERT_EQ(screen.pixels[1][0], 0x00);
+}
+
+TEST(Chip8, MegaChipBlend) {
+  // arrange
+  MegaChipScreen screen;
+  screen.reset();
+  vector<uint8_t> sprite(20, 200);
+  uint8_t results[5];
+
+  // act
+  for (auto mode = 0; mode < 5; mode++) {
+    memset(screen.pixels[mode], 100, MEGACHIP_WIDTH);
+    screen.blend = MegaChipBlend(mode);
+    screen.blit(sprite.data(), 20, 1, 0, mode);
+  }
+
+  // assert, the first 16 pixels take the vector path, the last 4 do not
+  for (auto mode = 0; mode < 5; mode++) {
+    results[mode] = screen.pixels[mode][0];
+    ASSERT_EQ(screen.pixels[mode][19], results[mode]);
+    ASSERT_EQ(screen.pixels[mode][20], 100);
+  }
+  ASSERT_EQ(results[0], 200);
+  ASSERT_EQ(results[1], 125);
+  ASSERT_EQ(results[2], 150);
+  ASSERT_EQ(results[3], 255);
+  ASSERT_EQ(results[4], 78);
+}
+
+TEST(Chip8, MegaChipPalette) {
+  // arrange
+  Chip8<MegaChipQuirks> cpu;
+  Chip8Presenter presenter;
+  auto& screen = *cpu.mega;
+  vector<uint8_t> argb{0xff, 0x10, 0x20, 0x30, 0x80, 0x40, 0x50, 0x60};
+  screen.enabled = true;
+  screen.pixels[0][0] = 1;
+  screen.pixels[0][1] = 2;
+  screen.pixels[1][0] = 1;
+
+  // act
+  screen.loadPalette(argb.data(), 2);
+  screen.scrollUp(1);
+  screen.alpha = 0x80;
+  auto frame = presenter.present(cpu);
+  auto out = static_cast<const uint32_t*>(frame.pixels);
+
+  // assert
+  ASSERT_EQ(frame.width, MEGACHIP_WIDTH);
+  ASSERT_EQ(frame.height, MEGACHIP_HEIGHT);
+  ASSERT_EQ(out[0], 0x80302010);
+  ASSERT_EQ(out[1], 0x00000000);
+  ASSERT_EQ(screen.palette[2], 0x80605040);
+  ASSERT_EQ(screen.pixels[MEGACHIP_HEIGHT - 1][0], 0);
+}
+
+TEST(Chip8, PresenterPalette) {
+  // arrange
+  Chip8<XoChipQuirks> cpu;
+  Chip8Presenter presenter;
+  Chip8Palette palette{{0x11111111, 0x22222222, 0x33333333, 0x44444444}};
+  cpu.screen.planes[0][0][0] = 0xa000000000000000ull;
+  cpu.screen.planes[1][0][0] = 0xc000000000000000ull;
+  cpu.screen.planes[1][1][0] = 0x0000000000000001ull;
+
+  // act
+  presenter.setPalette(palette);
+  auto frame = presenter.present(cpu);
+  auto out = static_cast<const uint32_t*>(frame.pixels);
+  auto first = out[0];
+  presenter.setPalette(*Chip8Palette::find("mono"));
+  presenter.present(cpu);
+
+  // assert
+  ASSERT_EQ(frame.format, Chip8PixelFormat::RGBA8888);
+  ASSERT_EQ(frame.width, CHIP8_VIDEO_WIDTH);
+  ASSERT_EQ(first, 0x44444444);
+  ASSERT_EQ(out[0], 0xff555555);
+  ASSERT_EQ(out[1], 0xffaaaaaa);
+  ASSERT_EQ(out[2], 0xffffffff);
+  ASSERT_EQ(out[3], 0x00000000);
+  ASSERT_EQ(out[2 * CHIP8_VIDEO_WIDTH - 1], 0xffaaaaaa);
+  ASSERT_EQ(Chip8Palette::find("unknown"), nullptr);
+}
+
+TEST(Chip8, PresenterRGB565) {
+  // arrange
+  Chip8 cpu;
+  Chip8Presenter presenter;
+  Chip8Palette palette{{0xff000000, 0xff0000ff, 0xff00ff00, 0xffff0000}};
+  cpu.screen.hires = true;
+  cpu.screen.planes[0][0][1] = 0x8000000000000001ull;
+
+  // act
+  presenter.setPalette(palette);
+  presenter.setFormat(Chip8PixelFormat::RGB565);
+  auto frame = presenter.present(cpu);
+  auto out = static_cast<const uint16_t*>(frame.pixels);
+
+  // assert
+  ASSERT_EQ(frame.format, Chip8PixelFormat::RGB565);
+  ASSERT_EQ(frame.width, CHIP8_HIRES_WIDTH);
+  ASSERT_EQ(out[0], 0x0000);
+  ASSERT_EQ(out[64], 0xf800);
+  ASSERT_EQ(out[65], 0x0000);
+  ASSERT_EQ(out[127], 0xf800);
+}
+
+TEST(Chip8, DirtyRows) {
+  // arrange
+  Chip8 cpu;
+  vector<uint8_t> code{0xd5, 0x62, 0x00, 0xe0};
+  vector<uint8_t> sprite{0xff, 0x00};
+  uint64_t rows[CHIP8_DIRTY_WORDS] = {};
+  cpu.index = 0x900;
+  cpu.registers[0x5] = 0x1;
+  cpu.registers[0x6] = 0x5;
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setMemory(cpu.index, sprite);
+
+  // act
+  cpu.execute();
+  cpu.dirtyRows(rows);
+  cpu.clearDirty();
+  auto cleared = cpu.screen.dirty;
+  cpu.execute();
+
+  // assert
+  ASSERT_EQ(rows[0], 1ull << 5);
+  ASSERT_EQ(rows[1], 0);
+  ASSERT_EQ(cleared, 0);
+  ASSERT_EQ(cpu.screen.dirty, ~0ull);
+}
+
+TEST(Chip8, MegaChipDirtyRows) {
+  // arrange
+  Chip8<MegaChipQuirks> cpu;
+  vector<uint8_t> sprite(4, 0x01);
+  uint64_t rows[CHIP8_DIRTY_WORDS] = {};
+  cpu.mega->enabled = true;
+
+  // act
+  cpu.mega->blit(sprite.data(), 2, 2, 0, 127);
+  cpu.dirtyRows(rows);
+
+  // assert
+  ASSERT_EQ(rows[0], 0);
+  ASSERT_EQ(rows[1], 1ull << 63);
+  ASSERT_EQ(rows[2], 1ull);
+}
+
+TEST(Chip8, PresenterDirtyRows) {
+  // arrange
+  Chip8 cpu;
+  Chip8Presenter presenter;
+  vector<uint8_t> code{0xd5, 0x61};
+  vector<uint8_t> sprite{0x80};
+  cpu.index = 0x900;
+  cpu.registers[0x6] = 0x3;
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setMemory(cpu.index, sprite);
+
+  // act
+  auto first = presenter.present(cpu);
+  cpu.clearDirty();
+  cpu.execute();
+  auto drawn = presenter.present(cpu);
+  auto pixel = static_cast<const uint32_t*>(drawn.pixels)[3 * 64];
+  cpu.clearDirty();
+  auto idle = presenter.present(cpu);
+  presenter.setPalette(*Chip8Palette::find("green"));
+  auto themed = presenter.present(cpu);
+
+  // assert
+  ASSERT_EQ(first.dirty[0], ~0ull);
+  ASSERT_EQ(drawn.dirty[0], 1ull << 3);
+  ASSERT_EQ(pixel, 0xffffffff);
+  ASSERT_EQ(idle.dirty[0], 0);
+  ASSERT_EQ(themed.dirty[0], ~0ull);
+}
+
+TEST(Chip8, FilterBlend) {
+  // arrange
+  Chip8FrameFilter filter;
+  vector<uint32_t> white(64 * 2, 0xffffffff);
+  vector<uint32_t> black(64 * 2, 0);
+  uint64_t dirty[CHIP8_DIRTY_WORDS] = {};
+  filter.setBlend(2);
+  filter.apply(white.data(), 64, 2, dirty);
+
+  // act
+  auto blended = filter.apply(black.data(), 64, 2, dirty)[64];
+  auto changed = dirty[0];
+  dirty[0] = 0;
+  auto faded = filter.apply(black.data(), 64, 2, dirty)[64];
+  dirty[0] = 0;
+  filter.apply(black.data(), 64, 2, dirty);
+
+  // assert
+  ASSERT_EQ(blended, 0x7f7f7f7f);
+  ASSERT_EQ(changed, 0x3);
+  ASSERT_EQ(faded, 0);
+  ASSERT_EQ(dirty[0], 0);
+}
+
+TEST(Chip8, FilterDecay) {
+  // arrange
+  Chip8 cpu;
+  Chip8Presenter presenter;
+  vector<uint8_t> code{0xd5, 0x61, 0xd5, 0x61};
+  vector<uint8_t> sprite{0x80};
+  cpu.index = 0x900;
+  cpu.registers[0x6] = 0x3;
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setMemory(cpu.index, sprite);
+  presenter.setDecay(128);
+  presenter.present(cpu);
+  cpu.clearDirty();
+
+  // act
+  cpu.execute();
+  auto lit = static_cast<const uint32_t*>(presenter.present(cpu).pixels)[192];
+  cpu.clearDirty();
+  cpu.execute();
+  auto frame = presenter.present(cpu);
+  auto fading = static_cast<const uint32_t*>(frame.pixels)[192];
+
+  // assert
+  ASSERT_EQ(lit, 0xffffffff);
+  ASSERT_EQ(fading, 0x7f7f7f7f);
+  ASSERT_EQ(frame.dirty[0], 1ull << 3);
+  ASSERT_EQ(cpu.screen.pixel(0, 3), 0);
+}
+
+TEST(Chip8, CreateProfile) {
+  // act
+  auto cosmac = Chip8Machine::create(Chip8Profile::Cosmac);
+  auto schip = Chip8Machine::create(Chip8Profile::SuperChip);
+
+  // assert
+  ASSERT_EQ(cosmac->profile(), Chip8Profile::Cosmac);
+  ASSERT_EQ(schip->profile(), Chip8Profile::SuperChip);
+  ASSERT_EQ(cosmac->pc, CHIP8_MEMORY_START);
+}
+
+TEST(Chip8, RunFrame) {
+  // arrange
+  Chip8 cpu;
+  vector<uint8_t> code{0x71, 0x01, 0x71, 0x01, 0x71, 0x01};
+  cpu.registers[0x1] = 0;
+  cpu.delayTimer = 2;
+  cpu.soundTimer = 0;
+
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+
+  // act
+  cpu.runFrame(3);
+
+  // assert
+  ASSERT_EQ(cpu.registers[0x1], 3);
+  ASSERT_EQ(cpu.pc, CHIP8_MEMORY_START + 6);
+  ASSERT_EQ(cpu.delayTimer, 1);
+  ASSERT_EQ(cpu.soundTimer, 0);
+}
+
+TEST(Chip8, CopyState) {
+  // arrange
+  Chip8 cpu;
+  Chip8 copy;
+  vector<uint8_t> code{0x61, 0x2a};
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setVideo(0x10, {1});
+  cpu.keyboard[0x3] = true;
+  cpu.delayTimer = 5;
+
+  // act
+  copy.copyState(cpu);
+  copy.execute();
+
+  // assert
+  ASSERT_EQ(copy.registers[0x1], 0x2a);
+  ASSERT_TRUE(copy.screen.pixel(0x10, 0));
+  ASSERT_EQ(copy.keyboard[0x3], true);
+  ASSERT_EQ(copy.delayTimer, 5);
+  ASSERT_EQ(cpu.pc, CHIP8_MEMORY_START);
+}
+
+TEST(Chip8, SpeculatorAdoptKeyToggle) {
+  // arrange
+  Chip8 cpu;
+  Chip8Speculator speculator{Chip8Profile::Modern, 4};
+  vector<uint8_t> code{0x61, 0x05, 0xe1, 0x9e, 0x62, 0x01, 0x63, 0x02};
+  cpu.registers[0x2] = 0;
+  cpu.registers[0x3] = 0;
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  bool keys[CHIP8_KEYS] = {};
+  keys[0x5] = true;
+
+  // act
+  speculator.speculate(cpu, 3);
+  auto adopted = speculator.adopt(keys, cpu);
+
+  // assert
+  ASSERT_EQ(adopted, true);
+  ASSERT_EQ(cpu.registers[0x2], 0);
+  ASSERT_EQ(cpu.registers[0x3], 2);
+  ASSERT_EQ(cpu.pc, CHIP8_MEMORY_START + 8);
+  ASSERT_EQ(speculator.hits(), 1);
+}
+
+TEST(Chip8, SpeculatorMiss) {
+  // arrange
+  Chip8 cpu;
+  Chip8Speculator speculator{Chip8Profile::Modern, 2};
+  vector<uint8_t> code{0x61, 0x05};
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  bool keys[CHIP8_KEYS] = {};
+  keys[0x1] = true;
+  keys[0x2] = true;
+
+  // act
+  speculator.speculate(cpu, 1);
+  auto adopted = speculator.adopt(keys, cpu);
+
+  // assert
+  ASSERT_EQ(adopted, false);
+  ASSERT_EQ(cpu.pc, CHIP8_MEMORY_START);
+  ASSERT_EQ(speculator.misses(), 1);
+}
+
+TEST(Chip8, EmulatorLoadFailure1) {
+  // arrange
+  Chip8 cpu;
+  ROMLoader loader{};
+
+  // act
+  auto result = loader.loadROM(cpu, "invalid_rom.ch8");
+
+  // assert
+  ASSERT_EQ(result, false);
+}
+
+TEST(Chip8, EmulatorLoadFailure2) {
+  // arrange
+  Chip8 cpu;
+  ROMLoader loader{};
+  ofstream rom{"invalid_rom.ch8", ios::out | ios::binary};
+  rom.close();
+
+  // act
+  auto result = loader.loadROM(cpu, "invalid_rom.ch8");
+
+  // assert
+  ASSERT_EQ(result, false);
+}
+
+TEST(Chip8, EmulatorLoadFailure3) {
+  // arrange
+  Chip8 cpu;
+  ROMLoader loader{};
+  ofstream rom{"invalid_rom.ch8", ios::out | ios::binary};
+  char opcode = 0x00;
+  for (auto i = 0; i < CHIP8_MEMORY_SIZE; i++) {
+    rom.write(&opcode, 1);
+  }
+  rom.close();
+
+  // act
+  auto result = loader.loadROM(cpu, "invalid_rom.ch8");
+
+  // assert
+  ASSERT_EQ(result, false);
+}
+
+TEST(Chip8, EmulatorLoadSuccess) {
+  // arrange
+  Chip8 cpu;
+  ROMLoader loader{};
+  ofstream rom{"valid_rom.ch8", ios::out | ios::binary};
+  char opcode = 0x00e0;
+  for (auto i = 0; i < 8; i++) {
+    rom.write(reinterpret_cast<const char*>(&opcode), 2);
+  }
+  rom.close();
+
+  // act
+  auto result = loader.loadROM(cpu, "valid_rom.ch8");
+
+  // assert
+  ASSERT_EQ(result, true);
+}
+
+TEST(Chip8, ROMDatabaseHash) {
+  // arrange
+  vector<uint8_t> data{'a'};
+
+  // act
+  auto hash = ROMDatabase::hash(data.data(), data.size());
+
+  // assert
+  ASSERT_EQ(hash, 0xaf63dc4c8601ec8cull);
+}
+
+TEST(Chip8, ROMDatabaseLookup) {
+  // act
+  auto known = ROMDatabase::lookup(0x7ce94f81f0ddb2f2);
+  auto unknown = ROMDatabase::lookup(0x1234);
+
+  // assert
+  ASSERT_NE(known, nullptr);
+  ASSERT_STREQ(known->name, "2-ibm-logo");
+  ASSERT_EQ(unknown, nullptr);
+}
+
+TEST(Chip8, ROMDatabaseGuessSuperChip) {
+  // arrange
+  vector<uint8_t> code{0x00, 0xe0, 0x00, 0xff, 0x12, 0x02};
+
+  // act
+  auto info = ROMDatabase::identify(code.data(), code.size());
+
+  // assert
+  ASSERT_EQ(info.profile, Chip8Profile::SuperChip);
+  ASSERT_EQ(info.name, nullptr);
+}
+
+TEST(Chip8, ROMDatabaseGuessXoChip) {
+  // arrange
+  vector<uint8_t> code{0x00, 0xff, 0xf3, 0x01, 0x12, 0x04};
+
+  // act
+  auto info = ROMDatabase::identify(code.data(), code.size());
+
+  // assert
+  ASSERT_EQ(info.profile, Chip8Profile::XoChip);
+}
+
+TEST(Chip8, ROMDatabaseGuessSkipsData) {
+  // arrange
+  vector<uint8_t> code{0x12, 0x04, 0x00, 0xff, 0x00, 0xe0, 0x12, 0x04};
+
+  // act
+  auto info = ROMDatabase::identify(code.data(), code.size());
+
+  // assert
+  ASSERT_EQ(info.profile, Chip8Profile::Modern);
+}
+
+TEST(Chip8, FontLoader) {
+  // arrange
+  Chip8 cpu;
+  FontLoader loader{};
+
+  // act
+  loader.loadFont(cpu);
+
+  // assert
+  ASSERT_EQ(cpu.memory[CHIP8_FONTS_START], loader.getFont(0, 0));
+  ASSERT_EQ(cpu.memory[CHIP8_FONTS_START + CHIP8_FONTS * CHIP8_FONT_SIZE - 1],
+            loader.getFont(0xf, 0x4));
+  ASSERT_EQ(cpu.memory[CHIP8_BIG_FONTS_START], 0x3c);
+  ASSERT_EQ(cpu.memory[CHIP8_BIG_FONTS_START +
+                       CHIP8_FONTS * CHIP8_BIG_FONT_SIZE - 1],
+            0xc0);
+}
+
+TEST(Chip8, AudioRingWrapAround) {
+  // arrange
+  AudioRing ring{};
+  vector<int16_t> in(CHIP8_AUDIO_RING - 10, 1);
+  vector<int16_t> out(CHIP8_AUDIO_RING, 0);
+  ring.write(in.data(), in.size());
+  ring.read(out.data(), in.size());
+  vector<int16_t> wrapped{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+
+  // act
+  auto written = ring.write(wrapped.data(), wrapped.size());
+  auto read = ring.read(out.data(), wrapped.size());
+
+  // assert
+  ASSERT_EQ(written, wrapped.size());
+  ASSERT_EQ(read, wrapped.size());
+  for (size_t i = 0; i < wrapped.size(); i++) {
+    ASSERT_EQ(out[i], wrapped[i]);
+  }
+  ASSERT_EQ(ring.size(), 0);
+}
+
+TEST(Chip8, AudioRingUnderrun) {
+  // arrange
+  AudioRing ring{};
+  vector<int16_t> in{1, 2, 3};
+  vector<int16_t> out(8, 0);
+  ring.write(in.data(), in.size());
+
+  // act
+  auto read = ring.read(out.data(), out.size());
+
+  // assert
+  ASSERT_EQ(read, in.size());
+  ASSERT_EQ(ring.underruns(), 1);
+}
+
+TEST(Chip8, AudioGeneratorBeep) {
+  // arrange
+  Chip8 cpu;
+  AudioRing ring{};
+  AudioGenerator generator{};
+  vector<int16_t> out(CHIP8_AUDIO_RING, 0);
+  cpu.soundTimer = 0;
+  generator.generate(cpu, ring, 100);
+  cpu.soundTimer = 10;
+
+  // act
+  generator.generate(cpu, ring, 100);
+  auto read = ring.read(out.data(), 200);
+
+  // assert
+  ASSERT_EQ(read, 200);
+  ASSERT_EQ(out[0], 0);
+  ASSERT_EQ(out[99], 0);
+  ASSERT_EQ(std::abs(out[100]), CHIP8_AUDIO_VOLUME);
+  ASSERT_EQ(std::abs(out[199]), CHIP8_AUDIO_VOLUME);
+}
+
+TEST(Chip8, AudioGeneratorPattern) {
+  // arrange
+  Chip8<XoChipQuirks> cpu;
+  AudioRing ring{};
+  AudioGenerator generator{};
+  vector<int16_t> out(CHIP8_AUDIO_RING, 0);
+  vector<uint8_t> code{0xf0, 0x02, 0xf1, 0x3a};  // audio, pitch v1
+  vector<uint8_t> pattern(XOCHIP_PATTERN, 0x00);
+  pattern[0] = 0xff;
+  cpu.index = 0x900;
+  cpu.registers[0x1] = XOCHIP_PITCH + 48;
+  cpu.soundTimer = 10;
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setMemory(cpu.index, pattern);
+
+  // act
+  cpu.execute();
+  generator.generate(cpu, ring, 100);
+  ring.read(out.data(), 100);
+  cpu.execute();
+  generator.generate(cpu, ring, 100);
+  ring.read(out.data() + 100, 100);
+
+  // assert
+  ASSERT_EQ(out[0], CHIP8_AUDIO_VOLUME);
+  ASSERT_EQ(out[80], CHIP8_AUDIO_VOLUME);
+  ASSERT_EQ(out[95], -CHIP8_AUDIO_VOLUME);
+  ASSERT_EQ(cpu.pitch, XOCHIP_PITCH + 48);
+  ASSERT_EQ(out[199], -CHIP8_AUDIO_VOLUME);
+}
+
+TEST(Chip8, AudioGeneratorLatency) {
+  // arrange
+  Chip8 cpu;
+  AudioRing ring{};
+  AudioGenerator generator{};
+  cpu.soundTimer = 10;
+
+  // act
+  for (auto i = 0; i < 10; i++) {
+    generator.generate(cpu, ring, 441);
+  }
+
+  // assert
+  ASSERT_EQ(ring.size(), CHIP8_AUDIO_LATENCY);
+}
+
+TEST(Chip8, EmulatorFrameSkip) {
+  // arrange
+  Chip8Emulator emulator{new SlowManager(12)};
+  ofstream rom{"loop_rom.ch8", ios::out | ios::binary};
+  rom.write("\x12\x00", 2);  // jp 0x200
+  rom.close();
+  emulator.setSync(Chip8Sync::Deadline);
+  emulator.setMaxFrameSkip(2);
+
+  // act
+  emulator.execute("loop_rom.ch8");
+
+  // assert
+  auto& metrics = emulator.metrics();
+  ASSERT_EQ(metrics.frames, 12);
+  ASSERT_GT(metrics.skippedFrames, 0);
+  ASSERT_EQ(metrics.presentedFrames + metrics.skippedFrames, metrics.frames);
+  ASSERT_LE(metrics.skippedFrames, 2 * metrics.presentedFrames);
+}
+
+TEST(Chip8, RecorderRaw) {
+  // arrange
+  vector<uint32_t> pixels(64 * 32, 0xff000000);
+  Chip8Frame frame{pixels.data(), 64, 32, Chip8PixelFormat::RGBA8888, {~0ull}};
+  uint64_t duplicates = 0;
+
+  // act
+  {
+    Chip8Recorder recorder{"recording.raw", Chip8RecordFormat::Raw, 0, 64,
+                           32};
+    recorder.display(frame);
+    recorder.display(frame);
+    pixels[0] = 0xffffffff;
+    recorder.display(frame);
+    frame.dirty[0] = 0;
+    recorder.display(frame);
+    duplicates = recorder.duplicates();
+  }
+  ifstream file{"recording.raw", ios::binary | ios::ate};
+
+  // assert
+  ASSERT_EQ(duplicates, 2);
+  ASSERT_EQ(file.tellg(), 4 * 64 * 32 * sizeof(uint32_t));
+}
+
+TEST(Chip8, RecorderGIF) {
+  // arrange
+  vector<uint32_t> pixels(64 * 32, 0xff000000);
+  Chip8Frame frame{pixels.data(), 64, 32, Chip8PixelFormat::RGBA8888, {~0ull}};
+
+  // act
+  {
+    Chip8Recorder recorder{"recording.gif",
+                           Chip8Recorder::formatOf("recording.gif")};
+    for (auto i = 0; i < 60; i++) {
+      pixels[i] = 0xffffffff;
+      recorder.display(frame);
+    }
+  }
+  ifstream file{"recording.gif", ios::binary};
+  string data{std::istreambuf_iterator<char>(file), {}};
+
+  // assert
+  ASSERT_EQ(data.substr(0, 6), "GIF89a");
+  ASSERT_EQ(data[6], char(CHIP8_RECORDER_WIDTH));
+  ASSERT_EQ(data.back(), 0x3b);
+}
+
+TEST(Chip8, StreamDelta) {
+  // arrange
+  Chip8 cpu;
+  Chip8StreamDecoder decoder;
+  vector<uint8_t> code{0xd5, 0x61};
+  vector<uint8_t> sprite{0xa5};
+  vector<uint8_t> hello{0x43, 0x38, 0x53, 0x54, CHIP8_STREAM_VERSION, 0, 0, 0};
+  vector<uint8_t> keyframe;
+  vector<uint8_t> delta;
+  cpu.index = 0x900;
+  cpu.registers[0x5] = 0x8;
+  cpu.registers[0x6] = 0x3;
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.setMemory(cpu.index, sprite);
+  Chip8Streamer::encode(cpu, 1, 10, true, keyframe);
+  cpu.clearDirty();
+
+  // act
+  cpu.execute();
+  Chip8Streamer::encode(cpu, 2, 11, false, delta);
+  decoder.feed(hello.data(), hello.size());
+  decoder.feed(keyframe.data(), keyframe.size());
+  decoder.feed(delta.data(), 5);
+  auto partial = decoder.messages;
+  auto ok = decoder.feed(delta.data() + 5, delta.size() - 5);
+
+  // assert
+  ASSERT_TRUE(ok);
+  ASSERT_EQ(partial, 1);
+  ASSERT_EQ(decoder.messages, 2);
+  ASSERT_EQ(decoder.sequence, 2);
+  ASSERT_EQ(decoder.timestamp, 11);
+  ASSERT_EQ(decoder.width, CHIP8_VIDEO_WIDTH);
+  ASSERT_EQ(delta[22], 1);
+  ASSERT_LT(delta.size(), 40);
+  for (auto x = 0; x < CHIP8_VIDEO_WIDTH; x++) {
+    ASSERT_EQ(decoder.pixel(x, 3), cpu.screen.pixel(x, 3));
+  }
+  ASSERT_EQ(decoder.pixel(8, 3), 1);
+  ASSERT_EQ(decoder.pixel(9, 3), 0);
+}
+
+TEST(Chip8, StreamSocket) {
+  // arrange
+  Chip8 cpu;
+  Chip8Streamer streamer;
+  Chip8StreamDecoder decoder;
+  auto listening = streamer.listen("unix:chip8-stream.sock");
+  auto client = Chip8Streamer::connect("unix:chip8-stream.sock");
+
+  // act
+  streamer.publish(cpu, 1);
+  streamer.publish(cpu, 2);
+  uint8_t buffer[1024];
+  auto n = read(client, buffer, sizeof(buffer));
+  decoder.feed(buffer, n > 0 ? n : 0);
+  close(client);
+
+  // assert
+  ASSERT_TRUE(listening);
+  ASSERT_GE(client, 0);
+  ASSERT_EQ(streamer.viewers(), 1);
+  ASSERT_EQ(decoder.messages, 2);
+  ASSERT_EQ(decoder.timestamp, 2);
+  ASSERT_EQ(streamer.sentBytes(), n);
+}
+
+TEST(Chip8, SharedState) {
+  // arrange
+  Chip8 cpu;
+  Chip8SharedState shared, second;
+  chip8_shm snapshot;
+  auto name = "/chip8-test-" + std::to_string(getpid());
+  cpu.registers[0x3] = 0x42;
+  cpu.screen.planes[0][5][0] = 0x8000000000000001ull;
+  auto opened = shared.open(name);
+
+  // act
+  shared.publish(cpu, 7);
+  auto begin = chip8_shm_begin(shared.data());
+  chip8_shm_snapshot(shared.data(), &snapshot);
+  auto stable = chip8_shm_retry(shared.data(), begin);
+  shared.publish(cpu, 8);
+  auto changed = chip8_shm_retry(shared.data(), begin);
+  auto taken = second.open(name);
+
+  // assert
+  ASSERT_TRUE(opened);
+  ASSERT_FALSE(taken);
+  ASSERT_EQ(snapshot.magic, CHIP8_SHM_MAGIC);
+  ASSERT_EQ(snapshot.size, sizeof(chip8_shm));
+  ASSERT_EQ(snapshot.sequence, 2);
+  ASSERT_EQ(snapshot.frame, 7);
+  ASSERT_EQ(snapshot.registers[0x3], 0x42);
+  ASSERT_EQ(snapshot.pc, CHIP8_MEMORY_START);
+  ASSERT_EQ(snapshot.width, CHIP8_VIDEO_WIDTH);
+  ASSERT_EQ(snapshot.planes[0][5][0], 0x8000000000000001ull);
+  ASSERT_FALSE(stable);
+  ASSERT_TRUE(changed);
+}
+
+TEST(Chip8, FanOutInline) {
+  // arrange
+  GatedSink first, second;
+  uint32_t pixels[CHIP8_VIDEO_WIDTH * CHIP8_VIDEO_HEIGHT] = {};
+  Chip8Frame frame{pixels, CHIP8_VIDEO_WIDTH, CHIP8_VIDEO_HEIGHT,
+                   Chip8PixelFormat::RGBA8888, {0x6, 0, 0}};
+  bool keys[CHIP8_KEYS] = {};
+  uint64_t bytes = 0;
+
+  // act
+  {
+    Chip8FanOut fanout;
+    fanout.add(new GatedManager(first), Chip8SinkMode::Inline);
+    fanout.add(new GatedManager(second), Chip8SinkMode::Inline);
+    for (auto i = 0; i < 3; i++) {
+      bytes += fanout.display(frame);
+    }
+    ASSERT_TRUE(fanout.handleKeys(keys));
+  }
+
+  // assert
+  ASSERT_EQ(bytes, 6);
+  ASSERT_EQ(first.frames, 3);
+  ASSERT_EQ(second.frames, 3);
+  ASSERT_EQ(second.rows, 0x6);
+}
+
+TEST(Chip8, FanOutDropOldest) {
+  // arrange
+  GatedSink window, slow;
+  uint32_t pixels[CHIP8_VIDEO_WIDTH * CHIP8_VIDEO_HEIGHT] = {};
+  Chip8Frame frame{pixels, CHIP8_VIDEO_WIDTH, CHIP8_VIDEO_HEIGHT,
+                   Chip8PixelFormat::RGBA8888, {}};
+  uint64_t drops = 0;
+  slow.open = false;
+
+  // act
+  {
+    Chip8FanOut fanout;
+    fanout.add(new GatedManager(window), Chip8SinkMode::Inline);
+    fanout.add(new GatedManager(slow), Chip8SinkMode::DropOldest);
+    frame.dirty[0] = 1;
+    fanout.display(frame);
+    while (!slow.entered) {
+      std::this_thread::yield();
+    }
+    for (auto row = 1; row < 6; row++) {
+      frame.dirty[0] = 1ull << row;
+      fanout.display(frame);
+    }
+    drops = fanout.dropped(1);
+    slow.open = true;
+  }
+
+  // assert
+  ASSERT_EQ(window.frames, 6);
+  ASSERT_EQ(drops, 3);
+  ASSERT_EQ(slow.frames, 3);
+  ASSERT_EQ(slow.rows, 0x3f);
+}
+
+TEST(Chip8, ROMPack) {
+  // arrange
+  vector<uint8_t> loop{0x12, 0x00};  // jp 0x200
+  vector<uint8_t> blank(600, 0);
+  blank[1] = 0xe0;  // cls
+  Chip8ROMPackBuilder builder;
+  auto added = builder.add("loop.ch8", loop) && builder.add("blank.ch8", blank);
+  auto duplicate = builder.add("loop.ch8", blank);
+  builder.write("test_pack.c8pk", true);
+  Chip8ROMPack pack;
+  Chip8 cpu;
+  ROMLoader loader;
+
+  // act
+  auto opened = pack.open("test_pack.c8pk");
+  auto byName = pack.find("blank.ch8");
+  auto byHash = pack.find(ROMDatabase::hash(loop.data(), loop.size()));
+  auto missing = pack.find("missing.ch8");
+  auto loaded = byName && pack.load(cpu, *byName);
+  auto read = loader.readROM("test_pack.c8pk:loop.ch8");
+
+  // assert
+  ASSERT_TRUE(added);
+  ASSERT_FALSE(duplicate);
+  ASSERT_TRUE(opened);
+  ASSERT_EQ(pack.count(), 2);
+  ASSERT_LT(pack.entry(0)->hash, pack.entry(1)->hash);
+  ASSERT_NE(byName, nullptr);
+  ASSERT_EQ(byName->flags, CHIP8_PACK_PACKED);
+  ASSERT_LT(byName->stored, blank.size());
+  ASSERT_NE(byHash, nullptr);
+  ASSERT_STREQ(pack.name(*byHash), "loop.ch8");
+  ASSERT_EQ(missing, nullptr);
+  ASSERT_TRUE(loaded);
+  ASSERT_EQ(memcmp(cpu.memory + CHIP8_MEMORY_START, blank.data(), blank.size()),
+            0);
+  ASSERT_TRUE(read);
+  ASSERT_EQ(loader.info().hash, byHash->hash);
+}
+
+TEST(Chip8, ROMPackCorrupt) {
+  // arrange
+  Chip8ROMPackBuilder builder;
+  builder.add("a.ch8", {0x12, 0x00});
+  builder.add("b.ch8", {0x00, 0xe0, 0x12, 0x02});
+  builder.write("corrupt_pack.c8pk", false);
+  ifstream file{"corrupt_pack.c8pk", ios::binary};
+  vector<uint8_t> valid{std::istreambuf_iterator<char>(file),
+                        std::istreambuf_iterator<char>()};
+  auto list = sizeof(Chip8PackHeader);
+  auto order = list + 2 * sizeof(Chip8PackEntry);
+  auto corrupt = [&](size_t at, const void* value, size_t size) {
+    auto bytes = valid;
+    memcpy(bytes.data() + at, value, size);
+    ofstream pack{"corrupt_pack.c8pk", ios::out | ios::binary};
+    pack.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    pack.close();
+    Chip8ROMPack opened;
+    return opened.open("corrupt_pack.c8pk");
+  };
+  uint32_t offset = 0xfffffff0;
+  uint64_t hash = ~uint64_t(0);
+  uint32_t names[2];
+  memcpy(names, valid.data() + order, sizeof(names));
+  std::swap(names[0], names[1]);
+
+  // act
+  auto intact = corrupt(0, valid.data(), 4);
+  auto pastEnd = corrupt(list + offsetof(Chip8PackEntry, offset), &offset, 4);
+  auto unsortedHashes = corrupt(list, &hash, sizeof(hash));
+  auto unsortedNames = corrupt(order, names, sizeof(names));
+
+  // assert
+  ASSERT_TRUE(intact);
+  ASSERT_FALSE(pastEnd);
+  ASSERT_FALSE(unsortedHashes);
+  ASSERT_FALSE(unsortedNames);
+}
+
+TEST(Chip8, SharedPages) {
+  // arrange
+  Chip8 original, first, second;
+  vector<uint8_t> code{0xa3, 0x00,   // ld i, 0x300
+                       0x60, 0x2a,   // ld v0, 0x2a
+                       0xf0, 0x55};  // ld [i], v0
+  original.setMemory(CHIP8_MEMORY_START, code);
+  auto image = original.snapshotMemory();
+  auto shared = first.shareMemory(image) && second.shareMemory(image);
+
+  // act
+  for (auto i = 0; i < 3; i++) {
+    first.execute();
+  }
+  second.copyState(first);
+  second.write(0x301, 7);
+  first.reset();
+
+  // assert
+  ASSERT_TRUE(shared);
+  ASSERT_EQ(first.memory, nullptr);
+  ASSERT_EQ(first.ownedPages(), 0);
+  ASSERT_EQ(first.read(0x300), 0);
+  ASSERT_EQ(first.read(CHIP8_MEMORY_START), 0xa3);
+  ASSERT_EQ(second.ownedPages(), 1);
+  ASSERT_EQ(second.read(0x300), 0x2a);
+  ASSERT_EQ(second.read(0x301), 7);
+  ASSERT_EQ(original.memory[0x300], 0);
+  ASSERT_EQ(image->bytes[0x300], 0);
+}
+
+TEST(Chip8, SharedLoad) {
+  // arrange
+  Chip8 original, cpu;
+  auto image = original.snapshotMemory();
+  cpu.shareMemory(image);
+  vector<uint8_t> rom(300, 0x12);
+  ofstream file{"shared_rom.ch8", ios::out | ios::binary};
+  file.write(reinterpret_cast<const char*>(rom.data()), rom.size());
+  file.close();
+  Chip8ROMPackBuilder builder;
+  builder.add("shared_rom.ch8", {0x00, 0xe0});
+  builder.write("shared_pack.c8pk", false);
+  Chip8ROMPack pack;
+  pack.open("shared_pack.c8pk");
+  ROMLoader loader;
+  FontLoader fonts;
+
+  // act
+  fonts.loadFont(cpu);
+  auto loaded = loader.loadROM(cpu, "shared_rom.ch8");
+  auto fromFile = cpu.read(CHIP8_MEMORY_START + 299);
+  auto packed = pack.load(cpu, *pack.find("shared_rom.ch8"));
+
+  // assert
+  ASSERT_EQ(cpu.memory, nullptr);
+  ASSERT_EQ(cpu.read(CHIP8_FONTS_START), 0xf0);
+  ASSERT_TRUE(loaded);
+  ASSERT_EQ(fromFile, 0x12);
+  ASSERT_TRUE(packed);
+  ASSERT_EQ(cpu.read(CHIP8_MEMORY_START + 1), 0xe0);
+  ASSERT_EQ(image->bytes[CHIP8_MEMORY_START + 1], 0);
+}
+
+TEST(Chip8, Fork) {
+  // arrange
+  Chip8 cpu, slot;
+  Chip8<CosmacQuirks> other;
+  vector<uint8_t> code{0xa3, 0x00,   // ld i, 0x300
+                       0x60, 0x2a,   // ld v0, 0x2a
+                       0xf0, 0x55,   // ld [i], v0
+                       0x70, 0x01,   // add v0, 1
+                       0xf0, 0x55};  // ld [i], v0
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.shareMemory(cpu.snapshotMemory());
+  for (auto i = 0; i < 3; i++) {
+    cpu.execute();
+  }
+
+  // act
+  auto forked = cpu.forkInto(slot);
+  auto mismatch = cpu.forkInto(other);
+  auto copy = cpu.clone();
+  slot.execute();
+  slot.execute();
+  copy->execute();
+
+  // assert
+  ASSERT_TRUE(forked);
+  ASSERT_FALSE(mismatch);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(&slot) % 64, 0);
+  ASSERT_EQ(slot.ownedPages(), 1);
+  ASSERT_EQ(slot.read(0x300), 0x2b);
+  ASSERT_EQ(cpu.read(0x300), 0x2a);
+  ASSERT_EQ(cpu.pc, CHIP8_MEMORY_START + 6);
+  ASSERT_EQ(copy->profile(), Chip8Profile::Modern);
+  ASSERT_EQ(copy->registers[0], 0x2b);
+  ASSERT_EQ(copy->read(0x300), 0x2a);
+}
+
+TEST(Chip8, RunAheadRandom) {
+  // arrange
+  Chip8 cpu, ahead;
+  vector<uint8_t> code{0xc0, 0xff,   // rnd v0, 0xff
+                       0xc1, 0xff};  // rnd v1, 0xff
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  cpu.shareMemory(cpu.snapshotMemory());
+  cpu.seedRandom(7);
+
+  // act
+  cpu.forkInto(ahead);
+  ahead.execute();
+  ahead.execute();
+  cpu.execute();
+  cpu.execute();
+
+  // assert
+  ASSERT_EQ(ahead.registers[0], cpu.registers[0]);
+  ASSERT_EQ(ahead.registers[1], cpu.registers[1]);
+  ASSERT_EQ(ahead.stateHash(), cpu.stateHash());
+}
+
+TEST(Chip8, Pool) {
+  // arrange
+  Chip8 cpu;
+  cpu.setMemory(CHIP8_MEMORY_START, {0x12, 0x00});  // jp 0x200
+  auto image = cpu.snapshotMemory();
+  Chip8Pool pool{Chip8Profile::Modern, 3};
+  auto hot = reinterpret_cast<uint8_t*>(cpu.registers) -
+             reinterpret_cast<uint8_t*>(&cpu) + sizeof(cpu.registers);
+
+  // act
+  auto first = pool.acquire(image);
+  auto second = pool.acquire(image);
+  auto third = pool.acquire(nullptr);
+  auto full = pool.acquire(image);
+  pool.release(second);
+  auto reused = pool.acquire(image);
+  pool[first].runFrame(10);
+
+  // assert
+  ASSERT_LE(hot, 64);
+  ASSERT_EQ(full, CHIP8_NO_HANDLE);
+  ASSERT_EQ(reused, second);
+  ASSERT_EQ(pool.size(), 3);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(&pool[first]) % 64, 0);
+  ASSERT_GT(&pool[second], &pool[first]);
+  ASSERT_EQ(pool[first].pc, CHIP8_MEMORY_START);
+  ASSERT_LT(pool[first].footprint(), 8192);
+  ASSERT_EQ(pool[third].footprint() - pool[first].footprint(),
+            CHIP8_MEMORY_SIZE);
+  ASSERT_GE(pool.footprint(),
+            pool[first].footprint() + pool[second].footprint() +
+                pool[third].footprint());
+}
+
+TEST(Chip8, StateHash) {
+  // arrange
+  Chip8 cpu, same, slot;
+  vector<uint8_t> code{0x60, 0x05,   // ld v0, 5
+                       0xa2, 0x0a,   // ld i, 0x20a
+                       0xd0, 0x01,   // drw v0, v0, 1
+                       0xd0, 0x01,   // drw v0, v0, 1
+                       0x12, 0x08,   // jp 0x208
+                       0xf0};        // sprite
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  same.setMemory(CHIP8_MEMORY_START, code);
+  cpu.enableStateHash();
+  same.enableStateHash();
+  auto start = cpu.stateHash();
+
+  // act
+  cpu.execute();
+  cpu.execute();
+  same.execute();
+  same.execute();
+  auto loaded = cpu.stateHash();
+  cpu.execute();
+  auto drawn = cpu.stateHash();
+  cpu.execute();
+  same.pc = cpu.pc;
+  same.registers[0xf] = cpu.registers[0xf];
+  cpu.write(0x300, 7);
+  auto written = cpu.stateHash();
+  cpu.write(0x300, 0);
+  cpu.forkInto(slot);
+
+  // assert
+  ASSERT_NE(loaded, start);
+  ASSERT_NE(drawn, loaded);
+  ASSERT_NE(written, same.stateHash());
+  ASSERT_EQ(cpu.stateHash(), same.stateHash());
+  ASSERT_EQ(slot.stateHash(), cpu.stateHash());
+}
+
+TEST(Chip8, Search) {
+  // arrange
+  Chip8 cpu;
+  cpu.setMemory(CHIP8_MEMORY_START,
+                {0xa3, 0x00,    // ld i, 0x300
+                 0x60, 0x05,    // ld v0, 5
+                 0xe0, 0x9e,    // skp v0
+                 0x12, 0x04,    // jp 0x204
+                 0x60, 0x03,    // ld v0, 3
+                 0xe0, 0x9e,    // skp v0
+                 0x12, 0x0a,    // jp 0x20a
+                 0x61, 0x2a,    // ld v1, 0x2a
+                 0xf1, 0x55,    // ld [i], v1
+                 0x12, 0x12});  // jp 0x212
+  Chip8SearchOptions options;
+  options.threads = 2;
+  options.maxDepth = 4;
+  options.goal.memory.emplace_back(0x301, 0x2a);
+  Chip8VisitedTable visited{4};
+
+  // act
+  auto breadth = Chip8Search{cpu, options}.run();
+  options.mode = Chip8SearchMode::Best;
+  auto best = Chip8Search{cpu, options}.run();
+  options.goal.memory[0].second = 0x2b;
+  auto missing = Chip8Search{cpu, options}.run();
+  auto inserted = visited.insert(42);
+  auto again = visited.insert(42);
+
+  // assert
+  ASSERT_TRUE(breadth.found);
+  ASSERT_EQ(breadth.inputs, (vector<int8_t>{5, 3}));
+  ASSERT_GT(breadth.duplicates, 0);
+  ASSERT_TRUE(best.found);
+  ASSERT_EQ(best.depth, 2);
+  ASSERT_FALSE(missing.found);
+  ASSERT_LE(missing.depth, 4);
+  ASSERT_TRUE(inserted);
+  ASSERT_FALSE(again);
+  ASSERT_EQ(visited.size(), 1);
+  ASSERT_EQ(cpu.pc, CHIP8_MEMORY_START);
+}
+
+TEST(Chip8, SearchReplay) {
+  // arrange
+  Chip8 cpu;
+  cpu.setMemory(CHIP8_MEMORY_START,
+                {0xa3, 0x00,    // ld i, 0x300
+                 0x61, 0x05,    // ld v1, 5
+                 0xe1, 0x9e,    // skp v1
+                 0x12, 0x04,    // jp 0x204
+                 0xc0, 0x0f,    // rnd v0, 0x0f
+                 0xf0, 0x55,    // ld [i], v0
+                 0x12, 0x04});  // jp 0x204
+  Chip8SearchOptions options;
+  options.threads = 2;
+  options.maxDepth = 8;
+  options.seed = 42;
+  options.goal.memory.emplace_back(0x300, 0x0a);
+  auto replay = cpu.clone();
+  replay->seedRandom(options.seed);
+
+  // act
+  auto first = Chip8Search{cpu, options}.run();
+  auto second = Chip8Search{cpu, options}.run();
+  for (auto input : first.inputs) {
+    for (auto key = 0; key < CHIP8_KEYS; key++) {
+      replay->keyboard[key] = key == input;
+    }
+    for (uint32_t frame = 0; frame < options.framesPerInput; frame++) {
+      replay->runFrame(options.cyclesPerFrame);
+    }
+  }
+
+  // assert
+  ASSERT_TRUE(first.found);
+  ASSERT_EQ(first.depth, second.depth);
+  ASSERT_EQ(replay->read(0x300), 0x0a);
+}
+
+TEST(Chip8, Environment) {
+  // arrange
+  Chip8 cpu;
+  cpu.setMemory(CHIP8_MEMORY_START,
+                {0xa3, 0x00,    // ld i, 0x300
+                 0x60, 0x01,    // ld v0, 1
+                 0xe0, 0xa1,    // sknp v0
+                 0x71, 0x01,    // add v1, 1
+                 0xf2, 0x55,    // ld [i], v2
+                 0xc2, 0xff,    // rnd v2, 0xff
+                 0x12, 0x04});  // jp 0x204
+  Chip8EnvironmentOptions options;
+  options.environments = 3;
+  options.threads = 2;
+  options.framesPerStep = 1;
+  options.cyclesPerFrame = 5;
+  options.rewards.push_back({0x301, 0.5f, true});
+  options.done.push_back({0x301, 3});
+  Chip8Environment first{cpu, options}, second{cpu, options};
+  vector<uint8_t> observations(3 * first.observationSize());
+  vector<int8_t> actions{1, CHIP8_ENV_NOOP, 1};
+  vector<float> rewards(3);
+  vector<uint8_t> dones(3);
+  vector<uint8_t> stepsToDone;
+
+  // act
+  first.reset(7, observations.data());
+  second.reset(8, observations.data());
+  for (auto step = 0; step < 4; step++) {
+    first.step(actions.data(), observations.data(), rewards.data(),
+               dones.data());
+    second.step(actions.data(), observations.data(), rewards.data(),
+                dones.data());
+    if (dones[0]) {
+      stepsToDone.push_back(step);
+    }
+  }
+  first.reset(7, observations.data());
+  second.reset(7, observations.data());
+  for (auto step = 0; step < 2; step++) {
+    first.step(actions.data(), observations.data(), rewards.data(),
+               dones.data());
+    second.step(actions.data(), observations.data(), rewards.data(),
+                dones.data());
+  }
+
+  // assert
+  ASSERT_EQ(first.size(), 3);
+  ASSERT_EQ(first.observationSize(), 256);
+  ASSERT_EQ(stepsToDone, (vector<uint8_t>{2}));
+  ASSERT_EQ(rewards[0], 0.5f);
+  ASSERT_EQ(rewards[1], 0.0f);
+  ASSERT_FALSE(dones[1]);
+  ASSERT_EQ(first[0].read(0x302), second[0].read(0x302));
+  ASSERT_NE(first[0].read(0x302), first[2].read(0x302));
+  ASSERT_EQ(cpu.pc, CHIP8_MEMORY_START);
+}
+
+TEST(Chip8, Observation) {
+  // arrange
+  vector<uint8_t> code{0xa2, 0x06,   // ld i, 0x206
+                       0xd0, 0x01,   // drw v0, v0, 1
+                       0x12, 0x04,   // jp 0x204
+                       0x12};        // sprite
+  Chip8 cpu;
+  Chip8<SuperChipQuirks> schip;
+  cpu.setMemory(CHIP8_MEMORY_START, code);
+  schip.setMemory(CHIP8_MEMORY_START, code);
+  Chip8EnvironmentOptions options;
+  Chip8Environment packed{cpu, options}, doubled{schip, options};
+  options.observation = Chip8ObservationMode::Downsampled;
+  options.block = 2;
+  Chip8Environment downsampled{cpu, options};
+  int8_t action = CHIP8_ENV_NOOP;
+  float reward;
+  uint8_t done;
+  vector<uint8_t> bits(packed.observationSize());
+  vector<uint8_t> hires(doubled.observationSize());
+  vector<uint8_t> blocks(downsampled.observationSize());
+
+  // act
+  packed.step(&action, bits.data(), &reward, &done);
+  doubled.step(&action, hires.data(), &reward, &done);
+  downsampled.step(&action, blocks.data(), &reward, &done);
+
+  // assert
+  ASSERT_EQ(bits.size(), 256);
+  ASSERT_EQ(bits[0], 0x12);
+  ASSERT_EQ(bits[8], 0);
+  ASSERT_EQ(hires.size(), 1024);
+  ASSERT_EQ(hires[0], 0x03);
+  ASSERT_EQ(hires[1], 0x0c);
+  ASSERT_EQ(hires[16], 0x03);
+  ASSERT_EQ(hires[32], 0);
+  ASSERT_EQ(downsampled.observationWidth(), 32);
+  ASSERT_EQ(blocks.size(), 512);
+  ASSERT_EQ(blocks[0], 0);
+  ASSERT_EQ(blocks[1], 63);
+  ASSERT_EQ(blocks[3], 63);
+  ASSERT_EQ(blocks[2], 0);
+}